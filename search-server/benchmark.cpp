@@ -0,0 +1,457 @@
+#include "corpus_loader.h"
+#include "numa_topology.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+// Reproducible benchmark of the search server. Every parameter has a default
+// and can be overridden as --name=value, e.g.
+//     benchmark --documents=100000 --zipf=1.1 --format=json
+// The same seed always produces the same corpus and queries, so the json output
+// of two commits can be compared directly; checksum changes when results do.
+
+using namespace std;
+
+struct BenchmarkConfig {
+    int documents = 10'000;
+    int vocabulary = 1'000;
+    int max_word_length = 10;
+    double zipf = 1.0;
+    int document_words = 70;
+    int queries = 100;
+    int query_words = 70;
+    double minus_prob = 0.1;
+    double duplicate_prob = 0.05;
+    double remove_fraction = 0.1;
+    int positions = 0;
+    int fuzzy = 0;
+    int max_writers = 32;
+    int numa = 0;
+    unsigned seed = 5489;
+    string format = "text"s;
+};
+
+BenchmarkConfig ParseArguments(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    const map<string_view, int*> int_options = {
+        {"documents"sv, &config.documents}, {"vocabulary"sv, &config.vocabulary},
+        {"max-word-length"sv, &config.max_word_length}, {"document-words"sv, &config.document_words},
+        {"queries"sv, &config.queries}, {"query-words"sv, &config.query_words},
+        {"positions"sv, &config.positions}, {"fuzzy"sv, &config.fuzzy},
+        {"max-writers"sv, &config.max_writers}, {"numa"sv, &config.numa}};
+    const map<string_view, double*> double_options = {
+        {"zipf"sv, &config.zipf}, {"minus-prob"sv, &config.minus_prob},
+        {"duplicate-prob"sv, &config.duplicate_prob}, {"remove-fraction"sv, &config.remove_fraction}};
+    for (int i = 1; i < argc; ++i) {
+        const string_view argument = argv[i];
+        const size_t eq = argument.find('=');
+        if (argument.substr(0, 2) != "--"sv || eq == argument.npos) {
+            throw invalid_argument("Expected --name=value, got "s + string{argument});
+        }
+        const string_view name = argument.substr(2, eq - 2);
+        const string value{argument.substr(eq + 1)};
+        if (int_options.count(name)) {
+            *int_options.at(name) = stoi(value);
+        } else if (double_options.count(name)) {
+            *double_options.at(name) = stod(value);
+        } else if (name == "seed"sv) {
+            config.seed = static_cast<unsigned>(stoul(value));
+        } else if (name == "format"sv && (value == "text"s || value == "json"s)) {
+            config.format = value;
+        } else {
+            throw invalid_argument("Unknown option "s + string{argument});
+        }
+    }
+    return config;
+}
+
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(uniform_int_distribution('a', 'z')(generator));
+    }
+    return word;
+}
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    shuffle(words.begin(), words.end(), generator);
+    return words;
+}
+
+// Word of rank r is drawn with probability proportional to 1 / r^exponent.
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t size, double exponent) {
+        cumulative_.reserve(size);
+        double sum = 0;
+        for (size_t rank = 1; rank <= size; ++rank) {
+            sum += 1.0 / pow(rank, exponent);
+            cumulative_.push_back(sum);
+        }
+    }
+
+    size_t operator()(mt19937& generator) const {
+        const double point = uniform_real_distribution<>(0, cumulative_.back())(generator);
+        const auto it = lower_bound(cumulative_.begin(), cumulative_.end(), point);
+        return min<size_t>(it - cumulative_.begin(), cumulative_.size() - 1);
+    }
+
+private:
+    vector<double> cumulative_;
+};
+
+string GenerateText(mt19937& generator, const vector<string>& dictionary, const ZipfDistribution& zipf,
+                    int word_count, double minus_prob) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            text.push_back('-');
+        }
+        text += dictionary[zipf(generator)];
+    }
+    return text;
+}
+
+struct BenchmarkResult {
+    string name;
+    size_t operations = 0;
+    double seconds = 0;
+    vector<int64_t> latencies_ns;
+    double checksum = 0;
+    long peak_rss_kb = 0;
+};
+
+long GetPeakRssKb() {
+#ifdef __unix__
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+double GetQuantileUs(vector<int64_t> latencies_ns, double quantile) {
+    if (latencies_ns.empty()) {
+        return 0;
+    }
+    const size_t index = min(latencies_ns.size() - 1, static_cast<size_t>(quantile * latencies_ns.size()));
+    nth_element(latencies_ns.begin(), latencies_ns.begin() + index, latencies_ns.end());
+    return latencies_ns[index] / 1000.0;
+}
+
+// Runs operation(i) for i in [0, count) and times every call.
+template <typename Operation>
+BenchmarkResult Measure(string name, size_t count, Operation operation) {
+    using Clock = chrono::steady_clock;
+    BenchmarkResult result;
+    result.name = move(name);
+    result.operations = count;
+    result.latencies_ns.reserve(count);
+    const auto start = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        const auto operation_start = Clock::now();
+        result.checksum += operation(i);
+        result.latencies_ns.push_back(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - operation_start).count());
+    }
+    result.seconds = chrono::duration<double>(Clock::now() - start).count();
+    result.peak_rss_kb = GetPeakRssKb();
+    return result;
+}
+
+template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
+double SumRelevance(const SearchServer& search_server, string_view query, ExecutionPolicy policy) {
+    double total_relevance = 0;
+    for (const auto& document : search_server.FindTopDocuments<Ranking>(policy, query)) {
+        total_relevance += document.relevance;
+    }
+    return total_relevance;
+}
+
+// Quoted pair of adjacent words from a random document.
+string GeneratePhraseQuery(mt19937& generator, const vector<string>& documents) {
+    const auto words = SplitIntoWordsView(documents[uniform_int_distribution<size_t>(0, documents.size() - 1)(generator)]);
+    const size_t first = uniform_int_distribution<size_t>(0, words.size() - 2)(generator);
+    return "\""s + string{words[first]} + " "s + string{words[first + 1]} + "\""s;
+}
+
+void PrintResults(const BenchmarkConfig& config, const vector<BenchmarkResult>& results,
+                  const IndexMemoryUsage& memory) {
+    if (config.format == "json"s) {
+        cout << "{\"config\": {\"documents\": "s << config.documents << ", \"vocabulary\": "s << config.vocabulary
+             << ", \"zipf\": "s << config.zipf << ", \"document_words\": "s << config.document_words
+             << ", \"queries\": "s << config.queries << ", \"query_words\": "s << config.query_words
+             << ", \"minus_prob\": "s << config.minus_prob << ", \"positions\": "s << config.positions
+             << ", \"fuzzy\": "s << config.fuzzy << ", \"numa\": "s << config.numa
+             << ", \"seed\": "s << config.seed << "},\n"s
+             << " \"index_memory\": {\"dictionary\": "s << memory.dictionary << ", \"postings\": "s << memory.postings
+             << ", \"forward_index\": "s << memory.forward_index << ", \"positions\": "s << memory.positions
+             << ", \"total\": "s << memory.Total() << "},\n"s
+             << " \"results\": ["s;
+        bool is_first = true;
+        for (const auto& result : results) {
+            cout << (is_first ? "\n"s : ",\n"s) << "  {\"name\": \""s << result.name
+                 << "\", \"operations\": "s << result.operations
+                 << ", \"seconds\": "s << result.seconds
+                 << ", \"ops_per_second\": "s << result.operations / result.seconds
+                 << ", \"p50_us\": "s << GetQuantileUs(result.latencies_ns, 0.5)
+                 << ", \"p99_us\": "s << GetQuantileUs(result.latencies_ns, 0.99)
+                 << ", \"p999_us\": "s << GetQuantileUs(result.latencies_ns, 0.999)
+                 << ", \"peak_rss_kb\": "s << result.peak_rss_kb
+                 << ", \"checksum\": "s << result.checksum << "}"s;
+            is_first = false;
+        }
+        cout << "\n ]}"s << endl;
+        return;
+    }
+    cout << "index memory: "s << memory.Total() << " B (dictionary "s << memory.dictionary
+         << ", postings "s << memory.postings << ", forward index "s << memory.forward_index
+         << ", positions "s << memory.positions << ")"s << endl;
+    for (const auto& result : results) {
+        cout << result.name << ": "s << result.operations << " ops in "s << result.seconds * 1000 << " ms, "s
+             << result.operations / result.seconds << " ops/s, p50 "s << GetQuantileUs(result.latencies_ns, 0.5)
+             << " us, p99 "s << GetQuantileUs(result.latencies_ns, 0.99)
+             << " us, p999 "s << GetQuantileUs(result.latencies_ns, 0.999)
+             << " us, peak rss "s << result.peak_rss_kb << " KB, checksum "s << result.checksum << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        const BenchmarkConfig config = ParseArguments(argc, argv);
+        if (config.numa != 0) {
+            // workers on their nodes, index pages spread over all nodes
+            TaskScheduler::SetDefaultPlacement(TaskScheduler::ThreadPlacement::NUMA_NODES);
+            InterleaveThreadMemory();
+        }
+        mt19937 generator(config.seed);
+        const auto dictionary = GenerateDictionary(generator, config.vocabulary, config.max_word_length);
+        const ZipfDistribution zipf(dictionary.size(), config.zipf);
+
+        vector<string> documents;
+        documents.reserve(config.documents);
+        for (int i = 0; i < config.documents; ++i) {
+            if (!documents.empty() && uniform_real_distribution<>(0, 1)(generator) < config.duplicate_prob) {
+                documents.push_back(documents[uniform_int_distribution<size_t>(0, documents.size() - 1)(generator)]);
+            } else {
+                documents.push_back(GenerateText(generator, dictionary, zipf, config.document_words, 0));
+            }
+        }
+        vector<string> queries;
+        queries.reserve(config.queries);
+        for (int i = 0; i < config.queries; ++i) {
+            queries.push_back(GenerateText(generator, dictionary, zipf, config.query_words, config.minus_prob));
+        }
+        vector<int> match_ids(queries.size());
+        for (auto& id : match_ids) {
+            id = uniform_int_distribution(0, config.documents - 1)(generator);
+        }
+
+        // separate stream, so adding phrases does not change the other stages
+        mt19937 phrase_generator(config.seed + 1);
+        vector<string> phrase_queries;
+        phrase_queries.reserve(config.queries);
+        for (int i = 0; i < config.queries && config.document_words > 1; ++i) {
+            phrase_queries.push_back(GeneratePhraseQuery(phrase_generator, documents));
+        }
+        vector<string> prefix_queries;
+        prefix_queries.reserve(config.queries);
+        for (int i = 0; i < config.queries; ++i) {
+            const string& word = dictionary[zipf(phrase_generator)];
+            prefix_queries.push_back(word.substr(0, min<size_t>(word.size(), 2)) + "*"s);
+        }
+        // the same short queries with one letter of one word replaced
+        vector<string> short_queries;
+        vector<string> typo_queries;
+        for (int i = 0; i < config.queries; ++i) {
+            vector<string> words;
+            for (int j = 0; j < 3; ++j) {
+                words.push_back(dictionary[zipf(phrase_generator)]);
+            }
+            string query = words[0] + " "s + words[1] + " "s + words[2];
+            string& typo_word = words[uniform_int_distribution(0, 2)(phrase_generator)];
+            typo_word[uniform_int_distribution<size_t>(0, typo_word.size() - 1)(phrase_generator)] =
+                uniform_int_distribution('a', 'z')(phrase_generator);
+            short_queries.push_back(move(query));
+            typo_queries.push_back(words[0] + " "s + words[1] + " "s + words[2]);
+        }
+
+        // every plus-word required, as in the AND query mode
+        auto require_all = [](string_view query) {
+            string result;
+            for (auto word : SplitIntoWordsView(query)) {
+                result += (word[0] == '-' ? ""s : "+"s) + string{word} + " "s;
+            }
+            return result;
+        };
+        vector<string> and_queries;
+        vector<string> short_and_queries;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            and_queries.push_back(require_all(queries[i]));
+            short_and_queries.push_back(require_all(short_queries[i]));
+        }
+
+        vector<BenchmarkResult> results;
+        SearchServer search_server(dictionary[0]);
+        if (config.positions != 0) {
+            search_server.EnablePositionalIndex();
+        }
+        if (config.fuzzy != 0) {
+            search_server.EnableFuzzySearch();
+        }
+        results.push_back(Measure("ingest"s, documents.size(), [&](size_t i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+            return 0.0;
+        }));
+        results.push_back(Measure("query_seq"s, queries.size(), [&](size_t i) {
+            return SumRelevance(search_server, queries[i], execution::seq);
+        }));
+        results.push_back(Measure("query_par"s, queries.size(), [&](size_t i) {
+            return SumRelevance(search_server, queries[i], execution::par);
+        }));
+        results.push_back(Measure("query_bm25"s, queries.size(), [&](size_t i) {
+            return SumRelevance<Bm25Ranking>(search_server, queries[i], execution::seq);
+        }));
+        results.push_back(Measure("query_phrase"s, phrase_queries.size(), [&](size_t i) {
+            return SumRelevance(search_server, phrase_queries[i], execution::seq);
+        }));
+        // the planner picks the execution, it must keep up with the better fixed one
+        results.push_back(Measure("query_auto"s, queries.size(), [&](size_t i) {
+            return SumRelevance(search_server, queries[i], adaptive_execution);
+        }));
+        results.push_back(Measure("query_phrase_auto"s, phrase_queries.size(), [&](size_t i) {
+            return SumRelevance(search_server, phrase_queries[i], adaptive_execution);
+        }));
+        results.push_back(Measure("query_prefix"s, prefix_queries.size(), [&](size_t i) {
+            return SumRelevance(search_server, prefix_queries[i], execution::seq);
+        }));
+        results.push_back(Measure("query_short"s, short_queries.size(), [&](size_t i) {
+            return SumRelevance(search_server, short_queries[i], execution::seq);
+        }));
+        results.push_back(Measure("query_typo"s, typo_queries.size(), [&](size_t i) {
+            return SumRelevance(search_server, typo_queries[i], execution::seq);
+        }));
+        results.push_back(Measure("query_short_and"s, short_and_queries.size(), [&](size_t i) {
+            return SumRelevance(search_server, short_and_queries[i], execution::seq);
+        }));
+        results.push_back(Measure("query_and"s, and_queries.size(), [&](size_t i) {
+            return SumRelevance(search_server, and_queries[i], execution::seq);
+        }));
+        const IndexMemoryUsage memory = search_server.GetIndexMemoryUsage();
+        results.push_back(Measure("process_queries"s, 1, [&](size_t) {
+            double total_relevance = 0;
+            for (const auto& document : ProcessQueriesJoined(search_server, queries)) {
+                total_relevance += document.relevance;
+            }
+            return total_relevance;
+        }));
+        results.push_back(Measure("match"s, queries.size(), [&](size_t i) {
+            const auto [words, status] = search_server.MatchDocument(queries[i], match_ids[i]);
+            return static_cast<double>(words.size());
+        }));
+        results.push_back(Measure("match_documents"s, queries.size(), [&](size_t i) {
+            return static_cast<double>(search_server.MatchDocuments(queries[i], match_ids).words.size());
+        }));
+        // moderation: ban a document and restore it, postings are untouched
+        results.push_back(Measure("update_status"s, match_ids.size(), [&](size_t i) {
+            search_server.UpdateDocumentStatus(match_ids[i], DocumentStatus::BANNED);
+            search_server.UpdateDocumentStatus(match_ids[i], DocumentStatus::ACTUAL);
+            return 0.0;
+        }));
+        results.push_back(Measure("dedup"s, 1, [&](size_t) {
+            return static_cast<double>(RemoveDuplicates(search_server).removed_ids.size());
+        }));
+        vector<int> remove_ids(search_server.begin(), search_server.end());
+        shuffle(remove_ids.begin(), remove_ids.end(), generator);
+        remove_ids.resize(static_cast<size_t>(remove_ids.size() * config.remove_fraction));
+        results.push_back(Measure("remove"s, remove_ids.size(), [&](size_t i) {
+            search_server.RemoveDocument(remove_ids[i]);
+            return 0.0;
+        }));
+
+        // the same documents once more, memory-mapped from a corpus file
+        const string corpus_path = (filesystem::temp_directory_path() / "search_server_benchmark_corpus.tsv").string();
+        {
+            ofstream corpus(corpus_path);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                corpus << i << "\tACTUAL\t1 2 3\t"s << documents[i] << '\n';
+            }
+        }
+        SearchServer mapped_server(dictionary[0]);
+        results.push_back(Measure("ingest_mapped"s, 1, [&](size_t) {
+            return static_cast<double>(LoadCorpus(mapped_server, corpus_path));
+        }));
+        filesystem::remove(corpus_path);
+
+        // ingest throughput with 1, 2, 4, ... concurrent writers, each run
+        // into a fresh server; ops/s counts documents
+        for (int writer_count = 1; writer_count <= config.max_writers; writer_count *= 2) {
+            SearchServer writers_server(dictionary[0]);
+            BenchmarkResult result = Measure("ingest_writers_"s + to_string(writer_count), 1, [&](size_t) {
+                vector<thread> writers;
+                for (int writer = 0; writer < writer_count; ++writer) {
+                    writers.emplace_back([&, writer] {
+                        for (size_t i = writer; i < documents.size(); i += writer_count) {
+                            writers_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+                        }
+                    });
+                }
+                for (auto& writer : writers) {
+                    writer.join();
+                }
+                return static_cast<double>(writers_server.GetDocumentCount());
+            });
+            result.operations = documents.size();
+            results.push_back(move(result));
+        }
+
+        // alerts as standing queries matched on ingest, instead of re-running
+        // them; checksum is the number of matches
+        SearchServer standing_server(dictionary[0]);
+        size_t standing_matches = 0;
+        for (const auto& query : short_queries) {
+            standing_server.AddStandingQuery(query, [&standing_matches](int, int) {
+                ++standing_matches;
+            });
+        }
+        results.push_back(Measure("ingest_standing"s, documents.size(), [&](size_t i) {
+            standing_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+            return i + 1 == documents.size() ? static_cast<double>(standing_matches) : 0.0;
+        }));
+
+        PrintResults(config, results, memory);
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <charconv>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "corpus_loader.h"
+#include "mapped_file.h"
+#include "task_scheduler.h"
+
+using namespace std;
+
+namespace {
+// a worker parses one chunk of about this size per step
+const size_t CORPUS_CHUNK_SIZE = 1 << 20;
+
+struct ParsedDocument {
+    CorpusRecord record;
+    vector<string_view> words;
+};
+
+string_view ExtractField(string_view& line) {
+    const size_t tab = line.find('\t');
+    if (tab == line.npos) {
+        throw invalid_argument("Corpus record has too few fields"s);
+    }
+    const string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+int ParseInt(string_view text) {
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc{} || end != text.data() + text.size()) {
+        throw invalid_argument("Invalid number "s + string{text} + " in corpus record"s);
+    }
+    return value;
+}
+
+DocumentStatus ParseStatus(string_view text) {
+    if (text == "ACTUAL"sv) {
+        return DocumentStatus::ACTUAL;
+    }
+    if (text == "IRRELEVANT"sv) {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (text == "BANNED"sv) {
+        return DocumentStatus::BANNED;
+    }
+    if (text == "REMOVED"sv) {
+        return DocumentStatus::REMOVED;
+    }
+    throw invalid_argument("Invalid status "s + string{text} + " in corpus record"s);
+}
+
+// Pieces of about CORPUS_CHUNK_SIZE bytes ending at line breaks.
+vector<string_view> SplitIntoChunks(string_view contents) {
+    vector<string_view> chunks;
+    while (!contents.empty()) {
+        size_t end = contents.find('\n', min(CORPUS_CHUNK_SIZE, contents.size() - 1));
+        end = end == contents.npos ? contents.size() : end + 1;
+        chunks.push_back(contents.substr(0, end));
+        contents.remove_prefix(end);
+    }
+    return chunks;
+}
+
+vector<ParsedDocument> ParseChunk(const SearchServer& server, string_view chunk) {
+    vector<ParsedDocument> documents;
+    while (!chunk.empty()) {
+        const size_t end = chunk.find('\n');
+        string_view line = chunk.substr(0, end);
+        chunk.remove_prefix(end == chunk.npos ? chunk.size() : end + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        CorpusRecord record = ParseCorpusRecord(line);
+        auto words = server.TokenizeDocument(record.text);
+        documents.push_back({move(record), move(words)});
+    }
+    return documents;
+}
+}
+
+CorpusRecord ParseCorpusRecord(string_view line) {
+    CorpusRecord record;
+    record.id = ParseInt(ExtractField(line));
+    record.status = ParseStatus(ExtractField(line));
+    string_view ratings = ExtractField(line);
+    while (!ratings.empty()) {
+        const size_t space = ratings.find(' ');
+        const string_view rating = ratings.substr(0, space);
+        ratings.remove_prefix(space == ratings.npos ? ratings.size() : space + 1);
+        if (!rating.empty()) {
+            record.ratings.push_back(ParseInt(rating));
+        }
+    }
+    if (record.ratings.empty()) {
+        throw invalid_argument("Corpus record has no ratings"s);
+    }
+    record.text = line;
+    return record;
+}
+
+size_t LoadCorpus(SearchServer& server, const string& path) {
+    const auto file = make_shared<const MappedFile>(path);
+    const auto chunks = SplitIntoChunks(file->GetContents());
+
+    auto& scheduler = TaskScheduler::Instance();
+    const size_t batch_size = scheduler.GetThreadCount();
+    vector<vector<ParsedDocument>> parsed;
+    vector<vector<ParsedDocument>> parsing;
+    size_t added = 0;
+    for (size_t begin = 0; begin < chunks.size() || !parsed.empty(); begin += batch_size) {
+        const size_t end = min(begin + batch_size, chunks.size());
+        parsing.clear();
+        parsing.resize(begin < end ? end - begin : 0);
+        // task 0 runs on this thread and indexes the previous batch, the
+        // workers parse the next one meanwhile
+        scheduler.ParallelFor(parsing.size() + 1, [&](size_t task) {
+            if (task > 0) {
+                parsing[task - 1] = ParseChunk(server, chunks[begin + task - 1]);
+                return;
+            }
+            for (const auto& chunk : parsed) {
+                for (const auto& [record, words] : chunk) {
+                    server.AddTokenizedDocument(record.id, record.text, words, record.status, record.ratings, file);
+                    ++added;
+                }
+            }
+        });
+        swap(parsed, parsing);
+    }
+    return added;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// A corpus file holds one document per line:
+//     <id>\t<status>\t<ratings>\t<text>
+// where status is ACTUAL, IRRELEVANT, BANNED or REMOVED, ratings are
+// one or more integers separated by spaces and the text runs to the end of the line.
+// Empty lines are skipped, "\r\n" line ends are accepted.
+struct CorpusRecord {
+    int id;
+    DocumentStatus status;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+// The text of the record is a view into the line.
+CorpusRecord ParseCorpusRecord(std::string_view line);
+
+// Memory-maps the file and indexes its records without copying the texts:
+// the server keeps the mapping alive. Records are parsed and tokenized on
+// the task scheduler's workers while the calling thread indexes the ones
+// parsed before. Returns the number of documents added.
+size_t LoadCorpus(SearchServer& server, const std::string& path);
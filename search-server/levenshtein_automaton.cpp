@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "levenshtein_automaton.h"
+
+using namespace std;
+
+pair<char32_t, size_t> DecodeUtf8(string_view text, size_t offset) {
+    const auto lead = static_cast<unsigned char>(text[offset]);
+    size_t length = 1;
+    char32_t code_point = lead;
+    if (lead >= 0xF0) {
+        length = 4;
+        code_point = lead & 0x07;
+    } else if (lead >= 0xE0) {
+        length = 3;
+        code_point = lead & 0x0F;
+    } else if (lead >= 0xC0) {
+        length = 2;
+        code_point = lead & 0x1F;
+    }
+    if (length == 1 || offset + length > text.size()) {
+        return {lead, 1};
+    }
+    for (size_t i = 1; i < length; ++i) {
+        const auto next = static_cast<unsigned char>(text[offset + i]);
+        if ((next & 0xC0) != 0x80) {
+            return {lead, 1};
+        }
+        code_point = (code_point << 6) | (next & 0x3F);
+    }
+    return {code_point, length};
+}
+
+LevenshteinAutomaton::LevenshteinAutomaton(string_view word, int max_distance)
+    : max_distance_(max_distance) {
+    if (max_distance < 0) {
+        throw invalid_argument("Edit distance must not be negative"s);
+    }
+    for (size_t offset = 0; offset < word.size();) {
+        const auto [code_point, length] = DecodeUtf8(word, offset);
+        word_.push_back(code_point);
+        offset += length;
+    }
+}
+
+LevenshteinAutomaton::State LevenshteinAutomaton::Start() const {
+    State state(word_.size() + 1);
+    for (size_t i = 0; i < state.size(); ++i) {
+        state[i] = static_cast<int>(i);
+    }
+    return state;
+}
+
+LevenshteinAutomaton::State LevenshteinAutomaton::Step(const State& state, char32_t code_point) const {
+    State next(state.size());
+    next[0] = state[0] + 1;
+    for (size_t i = 1; i < state.size(); ++i) {
+        const int substitution = state[i - 1] + (word_[i - 1] == code_point ? 0 : 1);
+        next[i] = min({next[i - 1] + 1, state[i] + 1, substitution});
+    }
+    return next;
+}
+
+bool LevenshteinAutomaton::CanMatch(const State& state) const {
+    return *min_element(state.begin(), state.end()) <= max_distance_;
+}
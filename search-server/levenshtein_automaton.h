@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Accepts the words within max_distance insertions, deletions and
+// substitutions of a given word, reading one UTF-8 code point per step.
+// A state is one row of the edit distance table: state[i] is the distance
+// between the text read so far and the first i code points of the word.
+// Rows are kept only while some entry is within max_distance, so a walk over
+// sorted words can drop every word sharing a prefix that lost all hope.
+class LevenshteinAutomaton {
+public:
+    using State = std::vector<int>;
+
+    LevenshteinAutomaton(std::string_view word, int max_distance);
+
+    State Start() const;
+    State Step(const State& state, char32_t code_point) const;
+
+    bool IsMatch(const State& state) const {
+        return state.back() <= max_distance_;
+    }
+
+    // False once no continuation of the text read so far can match.
+    bool CanMatch(const State& state) const;
+
+    int GetDistance(const State& state) const {
+        return state.back();
+    }
+
+private:
+    std::vector<char32_t> word_;
+    int max_distance_;
+};
+
+// Decodes the code point starting at text[offset] and returns it with its
+// length in bytes. Invalid bytes are returned one by one as themselves.
+std::pair<char32_t, size_t> DecodeUtf8(std::string_view text, size_t offset);
@@ -3,22 +3,23 @@
 #include <chrono>
 #include <iostream>
 #include <string>
+#include <string_view>
 
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
 #define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
-#define LOG_DURATION_STREAM(x, stream) LogDuration UIQUE_VAR_NAME_PROFILE(x, stream)
+#define LOG_DURATION_STREAM(x, stream) LogDuration UNIQUE_VAR_NAME_PROFILE(x, stream)
 
 class LogDuration {
 public:
     using Clock = std::chrono::steady_clock;
 
-    LogDuration(const std::string& id)
+    LogDuration(std::string_view id)
         : id_(id) {
         }
 
-    LogDuration(const std::string& id, std::ostream& stream)
+    LogDuration(std::string_view id, std::ostream& stream)
         : id_(id)
         , stream_(stream) {
     }
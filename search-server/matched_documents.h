@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// Result of matching one query against many documents, stored in flat arrays.
+// Matched words of the i-th document are words[offsets[i]] .. words[offsets[i + 1] - 1].
+struct MatchedDocuments {
+    std::vector<std::string_view> words;
+    std::vector<size_t> offsets;
+    std::vector<DocumentStatus> statuses;
+
+    size_t size() const {
+        return statuses.size();
+    }
+};
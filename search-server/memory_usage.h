@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+// Heap estimates count container capacities plus this much per std::map
+// node: the color and three pointers of a red-black tree node.
+constexpr size_t MAP_NODE_OVERHEAD = 32;
+
+// Estimated heap bytes of the search index, excluding the document texts.
+struct IndexMemoryUsage {
+    size_t dictionary = 0;
+    size_t postings = 0;
+    size_t forward_index = 0;
+    size_t positions = 0;
+
+    size_t Total() const {
+        return dictionary + postings + forward_index + positions;
+    }
+};
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include "metrics.h"
+
+using namespace std;
+
+namespace {
+
+// Written only by the owning thread, read by GetSnapshot from any thread.
+struct ThreadCounters {
+    array<atomic<uint64_t>, Metrics::METRIC_COUNT> counts{};
+    array<atomic<uint64_t>, Metrics::METRIC_COUNT> sums_ns{};
+    array<array<atomic<uint64_t>, Metrics::HISTOGRAM_SIZE>, Metrics::METRIC_COUNT> buckets{};
+};
+
+void Increment(atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+void AddTo(Metrics::Snapshot& snapshot, const ThreadCounters& counters) {
+    for (size_t m = 0; m < Metrics::METRIC_COUNT; ++m) {
+        auto& histogram = snapshot.histograms[m];
+        histogram.count += counters.counts[m].load(memory_order_relaxed);
+        histogram.sum_ns += counters.sums_ns[m].load(memory_order_relaxed);
+        for (size_t b = 0; b < Metrics::HISTOGRAM_SIZE; ++b) {
+            histogram.buckets[b] += counters.buckets[m][b].load(memory_order_relaxed);
+        }
+    }
+}
+
+struct Registry {
+    std::mutex mutex;
+    set<const ThreadCounters*> live;
+    // counters of threads that have already exited
+    Metrics::Snapshot retired;
+};
+
+Registry& GetRegistry() {
+    // never destroyed: thread_local counters may unregister during static destruction
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+struct ThreadRegistration {
+    unique_ptr<ThreadCounters> counters = make_unique<ThreadCounters>();
+
+    ThreadRegistration() {
+        auto& registry = GetRegistry();
+        lock_guard guard(registry.mutex);
+        registry.live.insert(counters.get());
+    }
+
+    ~ThreadRegistration() {
+        auto& registry = GetRegistry();
+        lock_guard guard(registry.mutex);
+        registry.live.erase(counters.get());
+        AddTo(registry.retired, *counters);
+    }
+};
+
+ThreadCounters& GetThreadCounters() {
+    thread_local ThreadRegistration registration;
+    return *registration.counters;
+}
+
+}
+
+atomic<bool> Metrics::enabled_{true};
+
+uint64_t Metrics::Histogram::GetQuantileNs(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = static_cast<uint64_t>(quantile * (count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < HISTOGRAM_SIZE; ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return GetBucketUpperBound(b);
+        }
+    }
+    return GetBucketUpperBound(HISTOGRAM_SIZE - 1);
+}
+
+void Metrics::Snapshot::WritePrometheus(ostream& output) const {
+    static constexpr double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+    for (size_t m = 0; m < METRIC_COUNT; ++m) {
+        const auto& histogram = histograms[m];
+        const string name = "search_server_"s + GetName(static_cast<Metric>(m)) + "_seconds"s;
+        output << "# TYPE "s << name << " summary\n"s;
+        for (const double quantile : QUANTILES) {
+            output << name << "{quantile=\""s << quantile << "\"} "s
+                   << histogram.GetQuantileNs(quantile) * 1e-9 << '\n';
+        }
+        output << name << "_sum "s << histogram.sum_ns * 1e-9 << '\n';
+        output << name << "_count "s << histogram.count << '\n';
+    }
+}
+
+void Metrics::SetEnabled(bool enabled) {
+    enabled_.store(enabled, memory_order_relaxed);
+}
+
+void Metrics::Record(Metric metric, uint64_t nanoseconds) {
+    auto& counters = GetThreadCounters();
+    const size_t m = static_cast<size_t>(metric);
+    Increment(counters.counts[m], 1);
+    Increment(counters.sums_ns[m], nanoseconds);
+    Increment(counters.buckets[m][ToBucket(nanoseconds)], 1);
+}
+
+Metrics::Snapshot Metrics::GetSnapshot() {
+    auto& registry = GetRegistry();
+    lock_guard guard(registry.mutex);
+    Snapshot snapshot = registry.retired;
+    for (const ThreadCounters* counters : registry.live) {
+        AddTo(snapshot, *counters);
+    }
+    return snapshot;
+}
+
+// Counters of running threads are cleared by another thread, so increments
+// racing with Reset may be lost.
+void Metrics::Reset() {
+    auto& registry = GetRegistry();
+    lock_guard guard(registry.mutex);
+    registry.retired = Snapshot{};
+    for (const ThreadCounters* counters : registry.live) {
+        auto& mutable_counters = const_cast<ThreadCounters&>(*counters);
+        for (size_t m = 0; m < METRIC_COUNT; ++m) {
+            mutable_counters.counts[m].store(0, memory_order_relaxed);
+            mutable_counters.sums_ns[m].store(0, memory_order_relaxed);
+            for (auto& bucket : mutable_counters.buckets[m]) {
+                bucket.store(0, memory_order_relaxed);
+            }
+        }
+    }
+}
+
+void Metrics::ExportPrometheus(const string& path) {
+    ofstream output(path);
+    if (!output) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    GetSnapshot().WritePrometheus(output);
+}
+
+const char* Metrics::GetName(Metric metric) {
+    switch (metric) {
+        case Metric::QUERY_PARSE: return "query_parse";
+        case Metric::POSTING_SCAN: return "posting_scan";
+        case Metric::MINUS_WORD_EXCLUSION: return "minus_word_exclusion";
+        case Metric::RESULT_MERGE: return "result_merge";
+        case Metric::RESULT_SORT: return "result_sort";
+        case Metric::DOCUMENT_MATCH: return "document_match";
+        case Metric::DOCUMENT_TOKENIZE: return "document_tokenize";
+        case Metric::DOCUMENT_INDEX: return "document_index";
+    }
+    return "unknown";
+}
+
+size_t Metrics::ToBucket(uint64_t nanoseconds) {
+    if (nanoseconds < SUB_BUCKET_COUNT) {
+        return nanoseconds;
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    const size_t top_bit = 63 - __builtin_clzll(nanoseconds);
+#else
+    size_t top_bit = 63;
+    while ((nanoseconds >> top_bit) == 0) {
+        --top_bit;
+    }
+#endif
+    const size_t shift = top_bit - SUB_BUCKET_BITS;
+    const size_t sub_bucket = (nanoseconds >> shift) & (SUB_BUCKET_COUNT - 1);
+    return (shift + 1) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t Metrics::GetBucketUpperBound(size_t bucket) {
+    if (bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    const size_t shift = bucket / SUB_BUCKET_COUNT - 1;
+    const uint64_t lower = (SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Hot-path timings of SearchServer. Instrumentation is compiled in only when
+// SEARCH_SERVER_METRICS is defined; otherwise the macros below expand to
+// nothing. When compiled in, recording can still be switched off at run time.
+//
+//     METRICS_TIMER(timer);
+//     ParseQuery();
+//     METRICS_CHECKPOINT(timer, Metric::QUERY_PARSE);   // time since METRICS_TIMER
+//     ScanPostings();
+//     METRICS_CHECKPOINT(timer, Metric::POSTING_SCAN);  // time since previous checkpoint
+
+enum class Metric {
+    QUERY_PARSE,
+    POSTING_SCAN,
+    MINUS_WORD_EXCLUSION,
+    RESULT_MERGE,
+    RESULT_SORT,
+    DOCUMENT_MATCH,
+    DOCUMENT_TOKENIZE,
+    DOCUMENT_INDEX,
+};
+
+class Metrics {
+public:
+    static constexpr size_t METRIC_COUNT = static_cast<size_t>(Metric::DOCUMENT_INDEX) + 1;
+    // HDR-style log-linear buckets: every power of two of nanoseconds is split
+    // into SUB_BUCKET_COUNT linear steps, which bounds the relative error of a
+    // quantile by 1 / SUB_BUCKET_COUNT
+    static constexpr size_t SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t{1} << SUB_BUCKET_BITS;
+    static constexpr size_t HISTOGRAM_SIZE = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    struct Histogram {
+        uint64_t count = 0;
+        uint64_t sum_ns = 0;
+        std::array<uint64_t, HISTOGRAM_SIZE> buckets{};
+
+        uint64_t GetQuantileNs(double quantile) const;
+    };
+
+    struct Snapshot {
+        std::array<Histogram, METRIC_COUNT> histograms;
+
+        // Prometheus text exposition format, one summary per metric
+        void WritePrometheus(std::ostream& output) const;
+    };
+
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    static void Record(Metric metric, uint64_t nanoseconds);
+    // sums the counters of all threads, including finished ones
+    static Snapshot GetSnapshot();
+    static void Reset();
+    static void ExportPrometheus(const std::string& path);
+
+    static const char* GetName(Metric metric);
+    static size_t ToBucket(uint64_t nanoseconds);
+    static uint64_t GetBucketUpperBound(size_t bucket);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+class MetricsTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    MetricsTimer()
+        : last_(Metrics::IsEnabled() ? Clock::now() : Clock::time_point{}) {
+    }
+
+    void Checkpoint(Metric metric) {
+        if (!Metrics::IsEnabled()) {
+            return;
+        }
+        const auto now = Clock::now();
+        if (last_ == Clock::time_point{}) {
+            // metrics were switched on after the timer had started
+            last_ = now;
+            return;
+        }
+        Metrics::Record(metric, std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count());
+        last_ = now;
+    }
+
+private:
+    Clock::time_point last_;
+};
+
+#ifdef SEARCH_SERVER_METRICS
+#define METRICS_TIMER(name) MetricsTimer name
+#define METRICS_CHECKPOINT(name, metric) name.Checkpoint(metric)
+#else
+#define METRICS_TIMER(name) static_cast<void>(0)
+#define METRICS_CHECKPOINT(name, metric) static_cast<void>(0)
+#endif
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "near_duplicates.h"
+#include "string_processing.h"
+
+using namespace std;
+
+NearDuplicateIndex::NearDuplicateIndex(NearDuplicateOptions options)
+    : options_(options) {
+    if (options_.band_count <= 0 || options_.rows_per_band <= 0) {
+        throw invalid_argument("Band count and rows per band must be positive"s);
+    }
+    if (options_.threshold < 0.0 || options_.threshold > 1.0) {
+        throw invalid_argument("Similarity threshold must be within [0, 1]"s);
+    }
+    bands_.resize(options_.band_count);
+}
+
+vector<int> NearDuplicateIndex::AddDocument(int document_id, const vector<string_view>& words) {
+    if (signatures_.count(document_id) > 0) {
+        throw invalid_argument("Document is already indexed"s);
+    }
+    if (words.empty()) {
+        return {};
+    }
+    auto signature = ComputeSignature(words);
+    auto near_duplicates = FindNearDuplicates(document_id, signature);
+    for (int band = 0; band < options_.band_count; ++band) {
+        bands_[band][HashBand(signature, band)].push_back(document_id);
+    }
+    signatures_.emplace(document_id, move(signature));
+    return near_duplicates;
+}
+
+void NearDuplicateIndex::RemoveDocument(int document_id) {
+    const auto it = signatures_.find(document_id);
+    if (it == signatures_.end()) {
+        return;
+    }
+    for (int band = 0; band < options_.band_count; ++band) {
+        const auto bucket = bands_[band].find(HashBand(it->second, band));
+        auto& ids = bucket->second;
+        ids.erase(find(ids.begin(), ids.end(), document_id));
+        if (ids.empty()) {
+            bands_[band].erase(bucket);
+        }
+    }
+    signatures_.erase(it);
+}
+
+vector<int> NearDuplicateIndex::FindNearDuplicates(int document_id) const {
+    const auto it = signatures_.find(document_id);
+    if (it == signatures_.end()) {
+        return {};
+    }
+    return FindNearDuplicates(document_id, it->second);
+}
+
+double NearDuplicateIndex::EstimateSimilarity(int lhs_id, int rhs_id) const {
+    return EstimateSimilarity(signatures_.at(lhs_id), signatures_.at(rhs_id));
+}
+
+// The i-th hash function is h1 + i * h2 (Kirsch-Mitzenmacher) put through the
+// finalizer, so every word is hashed only twice regardless of the signature
+// length, yet the minima of different rows do not follow one another.
+NearDuplicateIndex::Signature NearDuplicateIndex::ComputeSignature(const vector<string_view>& words) const {
+    Signature signature(options_.band_count * options_.rows_per_band, numeric_limits<uint64_t>::max());
+    for (auto word : words) {
+        const uint64_t h1 = HashWord(word, 0x9e3779b97f4a7c15ULL);
+        const uint64_t h2 = HashWord(word, 0xc2b2ae3d27d4eb4fULL) | 1;
+        uint64_t hash = h1;
+        for (auto& min_hash : signature) {
+            min_hash = min(min_hash, MixHash(hash));
+            hash += h2;
+        }
+    }
+    return signature;
+}
+
+uint64_t NearDuplicateIndex::HashBand(const Signature& signature, int band) const {
+    uint64_t hash = 0xcbf29ce484222325ULL + band;
+    const auto first = signature.begin() + band * options_.rows_per_band;
+    for (auto it = first; it != first + options_.rows_per_band; ++it) {
+        hash = (hash ^ *it) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+double NearDuplicateIndex::EstimateSimilarity(const Signature& lhs, const Signature& rhs) {
+    size_t equal_count = 0;
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        equal_count += lhs[i] == rhs[i];
+    }
+    return static_cast<double>(equal_count) / lhs.size();
+}
+
+vector<int> NearDuplicateIndex::FindNearDuplicates(int document_id, const Signature& signature) const {
+    vector<int> candidates;
+    for (int band = 0; band < options_.band_count; ++band) {
+        const auto bucket = bands_[band].find(HashBand(signature, band));
+        if (bucket != bands_[band].end()) {
+            candidates.insert(candidates.end(), bucket->second.begin(), bucket->second.end());
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    vector<int> result;
+    for (int candidate : candidates) {
+        if (candidate != document_id
+            && EstimateSimilarity(signature, signatures_.at(candidate)) >= options_.threshold) {
+            result.push_back(candidate);
+        }
+    }
+    return result;
+}
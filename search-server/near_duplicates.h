@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct NearDuplicateOptions {
+    // signature length is band_count * rows_per_band; a pair with Jaccard
+    // similarity s becomes a candidate with probability 1 - (1 - s^rows)^bands
+    int band_count = 16;
+    int rows_per_band = 4;
+    // minimal estimated Jaccard similarity of word sets to report a pair
+    double threshold = 0.8;
+};
+
+// Called with the id of a newly added document and the ids of earlier
+// documents similar to it, in ascending order.
+using NearDuplicateCallback = std::function<void(int document_id, const std::vector<int>& near_duplicate_ids)>;
+
+// MinHash signatures of document word sets with an LSH banding index.
+// Documents are added one at a time, so the index stays current while the
+// corpus grows and every insertion reports the near-duplicates of the new
+// document.
+class NearDuplicateIndex {
+public:
+    explicit NearDuplicateIndex(NearDuplicateOptions options = {});
+
+    // Indexes the document and returns ids of previously added documents
+    // similar to it, in ascending order. A document without words is not
+    // indexed: empty word sets would all look identical.
+    std::vector<int> AddDocument(int document_id, const std::vector<std::string_view>& words);
+    void RemoveDocument(int document_id);
+
+    std::vector<int> FindNearDuplicates(int document_id) const;
+    double EstimateSimilarity(int lhs_id, int rhs_id) const;
+
+private:
+    using Signature = std::vector<std::uint64_t>;
+
+    Signature ComputeSignature(const std::vector<std::string_view>& words) const;
+    std::uint64_t HashBand(const Signature& signature, int band) const;
+    static double EstimateSimilarity(const Signature& lhs, const Signature& rhs);
+    std::vector<int> FindNearDuplicates(int document_id, const Signature& signature) const;
+
+    NearDuplicateOptions options_;
+    std::map<int, Signature> signatures_;
+    std::vector<std::unordered_map<std::uint64_t, std::vector<int>>> bands_;
+};
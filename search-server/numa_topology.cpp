@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "numa_topology.h"
+
+using namespace std;
+
+namespace {
+const char* const NODE_DIRECTORY = "/sys/devices/system/node";
+
+// "0-3,8,10-11" -> 0 1 2 3 8 10 11
+vector<int> ParseCpuList(string_view list) {
+    vector<int> cpus;
+    while (!list.empty()) {
+        const size_t comma = list.find(',');
+        const string range{list.substr(0, comma)};
+        list.remove_prefix(comma == list.npos ? list.size() : comma + 1);
+        if (range.empty() || range == "\n"s) {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const int first = stoi(range.substr(0, dash));
+        const int last = dash == range.npos ? first : stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// node number -> CPUs, only nodes that have CPUs
+vector<pair<int, vector<int>>> ReadNodes() {
+    vector<pair<int, vector<int>>> nodes;
+    error_code error;
+    for (const auto& entry : filesystem::directory_iterator(NODE_DIRECTORY, error)) {
+        const string name = entry.path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node"s) != 0
+            || name.find_first_not_of("0123456789"s, 4) != name.npos) {
+            continue;
+        }
+        ifstream input(entry.path() / "cpulist");
+        string list;
+        if (getline(input, list)) {
+            auto cpus = ParseCpuList(list);
+            if (!cpus.empty()) {
+                nodes.push_back({stoi(name.substr(4)), move(cpus)});
+            }
+        }
+    }
+    sort(nodes.begin(), nodes.end());
+    return nodes;
+}
+}
+
+vector<vector<int>> GetNumaNodeCpus() {
+    vector<vector<int>> node_cpus;
+    for (auto& [node, cpus] : ReadNodes()) {
+        node_cpus.push_back(move(cpus));
+    }
+    if (node_cpus.empty()) {
+        node_cpus.emplace_back();
+        for (unsigned cpu = 0; cpu < max(thread::hardware_concurrency(), 1u); ++cpu) {
+            node_cpus.back().push_back(static_cast<int>(cpu));
+        }
+    }
+    return node_cpus;
+}
+
+bool PinThreadToCpus(const vector<int>& cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+bool InterleaveThreadMemory() {
+#ifdef __linux__
+    const auto nodes = ReadNodes();
+    if (nodes.size() < 2) {
+        return false;
+    }
+    const size_t bits_per_word = 8 * sizeof(unsigned long);
+    vector<unsigned long> mask(nodes.back().first / bits_per_word + 1, 0);
+    for (const auto& [node, cpus] : nodes) {
+        mask[node / bits_per_word] |= 1ul << (node % bits_per_word);
+    }
+    return syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, mask.data(), mask.size() * bits_per_word + 1) == 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+
+// CPUs of every NUMA node, read from sysfs on Linux. Machines without NUMA
+// information look like one node holding every CPU.
+std::vector<std::vector<int>> GetNumaNodeCpus();
+
+// Restricts the calling thread to the given CPUs; false if the system
+// refused or does not support it.
+bool PinThreadToCpus(const std::vector<int>& cpus);
+
+// Spreads the pages the calling thread touches from now on over all NUMA
+// nodes round-robin, so an index built by one thread does not live on a
+// single node. False on machines with one node or without support.
+bool InterleaveThreadMemory();
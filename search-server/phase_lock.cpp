@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <vector>
+
+#include "phase_lock.h"
+
+using namespace std;
+
+namespace {
+// read sides held by this thread, once per nested lock
+thread_local vector<const PhaseLock*> held_reads;
+}
+
+PhaseLock::Side::Side(PhaseLock& owner, int index)
+    : owner_(owner)
+    , index_(index) {
+}
+
+void PhaseLock::Side::lock() {
+    owner_.Enter(index_);
+}
+
+void PhaseLock::Side::unlock() {
+    owner_.Leave(index_);
+}
+
+PhaseLock::PhaseLock()
+    : readers(*this, READ)
+    , writers(*this, WRITE) {
+}
+
+void PhaseLock::Enter(int side) {
+    if (side == READ) {
+        const bool nested = find(held_reads.begin(), held_reads.end(), this) != held_reads.end();
+        held_reads.push_back(this);
+        if (nested) {
+            return;
+        }
+    }
+    const int other = 1 - side;
+    unique_lock lock(mutex_);
+    auto is_free = [this, other] {
+        return active_[other] == 0 && waiting_[other] == 0 && admitted_[other] == 0;
+    };
+    if (!is_free()) {
+        ++waiting_[side];
+        changed_.wait(lock, [this, side, &is_free] {
+            return admitted_[side] > 0 || is_free();
+        });
+        --waiting_[side];
+        if (admitted_[side] > 0) {
+            --admitted_[side];
+        }
+    }
+    ++active_[side];
+}
+
+void PhaseLock::Leave(int side) {
+    if (side == READ) {
+        held_reads.erase(find(held_reads.rbegin(), held_reads.rend(), this).base() - 1);
+        if (find(held_reads.begin(), held_reads.end(), this) != held_reads.end()) {
+            return;
+        }
+    }
+    const int other = 1 - side;
+    lock_guard guard(mutex_);
+    --active_[side];
+    if (active_[side] == 0 && admitted_[side] == 0) {
+        admitted_[other] = waiting_[other];
+        changed_.notify_all();
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+// Lets in any number of threads of one side at a time, readers or writers,
+// never both: writers still share the index among themselves behind their own
+// finer locks, while a reader never sees half of a write. A side that waits
+// is let in as a batch once the other side leaves, and meanwhile newcomers of
+// the other side queue, so neither side starves.
+//
+// The read side may be re-entered by a thread that already holds it, since a
+// query calls other queries of the same server. Threads that only help a
+// reader, e.g. the tasks of a parallel query, must not lock it again.
+class PhaseLock {
+public:
+    class Side {
+    public:
+        void lock();
+        void unlock();
+
+    private:
+        friend class PhaseLock;
+        Side(PhaseLock& owner, int index);
+
+        PhaseLock& owner_;
+        int index_;
+    };
+
+    PhaseLock();
+    PhaseLock(const PhaseLock&) = delete;
+    PhaseLock& operator=(const PhaseLock&) = delete;
+
+    Side readers;
+    Side writers;
+
+private:
+    static const int READ = 0;
+    static const int WRITE = 1;
+
+    void Enter(int side);
+    void Leave(int side);
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    int active_[2] = {0, 0};
+    int waiting_[2] = {0, 0};
+    // waiters of a side let in by the last holder of the other side
+    int admitted_[2] = {0, 0};
+};
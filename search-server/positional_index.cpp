@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "positional_index.h"
+#include "memory_usage.h"
+
+using namespace std;
+
+namespace {
+void AppendVarint(uint32_t value, vector<uint8_t>& out) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+}
+
+void PositionalIndex::AddDocument(int document_id, const vector<int>& term_ids) {
+    if (documents_.count(document_id) > 0) {
+        throw invalid_argument("Document is already indexed"s);
+    }
+    // positions grouped by term, ascending within a term
+    vector<int> order(term_ids.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(),
+                [&term_ids](int lhs, int rhs) {
+                    return term_ids[lhs] < term_ids[rhs];
+                });
+
+    DocumentPositions positions;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const int term_id = term_ids[order[i]];
+        int previous = 0;
+        if (positions.term_ids.empty() || positions.term_ids.back() != term_id) {
+            positions.term_ids.push_back(term_id);
+            positions.offsets.push_back(static_cast<uint32_t>(positions.data.size()));
+        } else {
+            previous = order[i - 1];
+        }
+        AppendVarint(static_cast<uint32_t>(order[i] - previous), positions.data);
+    }
+    positions.offsets.push_back(static_cast<uint32_t>(positions.data.size()));
+    positions.term_ids.shrink_to_fit();
+    positions.offsets.shrink_to_fit();
+    positions.data.shrink_to_fit();
+    documents_.emplace(document_id, move(positions));
+}
+
+void PositionalIndex::RemoveDocument(int document_id) {
+    documents_.erase(document_id);
+}
+
+vector<int> PositionalIndex::GetPositions(int document_id, int term_id) const {
+    const auto document = documents_.find(document_id);
+    if (document == documents_.end()) {
+        return {};
+    }
+    const auto& term_ids = document->second.term_ids;
+    const auto term = lower_bound(term_ids.begin(), term_ids.end(), term_id);
+    if (term == term_ids.end() || *term != term_id) {
+        return {};
+    }
+    const size_t index = term - term_ids.begin();
+    const auto& data = document->second.data;
+    vector<int> positions;
+    int position = 0;
+    uint32_t delta = 0;
+    int shift = 0;
+    for (uint32_t i = document->second.offsets[index]; i < document->second.offsets[index + 1]; ++i) {
+        delta |= static_cast<uint32_t>(data[i] & 0x7f) << shift;
+        if (data[i] & 0x80) {
+            shift += 7;
+            continue;
+        }
+        position += static_cast<int>(delta);
+        positions.push_back(position);
+        delta = 0;
+        shift = 0;
+    }
+    return positions;
+}
+
+bool PositionalIndex::ContainsPhrase(int document_id, const vector<int>& term_ids) const {
+    if (term_ids.empty()) {
+        return true;
+    }
+    // starts[j] is a position where the first k phrase terms were found in a row
+    vector<int> starts = GetPositions(document_id, term_ids[0]);
+    for (size_t k = 1; k < term_ids.size() && !starts.empty(); ++k) {
+        const vector<int> positions = GetPositions(document_id, term_ids[k]);
+        auto position = positions.begin();
+        starts.erase(
+            remove_if(starts.begin(), starts.end(),
+                      [&position, &positions, k](int start) {
+                          position = lower_bound(position, positions.end(), start + static_cast<int>(k));
+                          return position == positions.end() || *position != start + static_cast<int>(k);
+                      }),
+            starts.end());
+    }
+    return !starts.empty();
+}
+
+size_t PositionalIndex::GetMemoryUsage() const {
+    size_t bytes = 0;
+    for (const auto& [document_id, positions] : documents_) {
+        bytes += MAP_NODE_OVERHEAD + sizeof(document_id) + sizeof(positions)
+            + positions.term_ids.capacity() * sizeof(int)
+            + positions.offsets.capacity() * sizeof(uint32_t)
+            + positions.data.capacity();
+    }
+    return bytes;
+}
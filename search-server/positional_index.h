@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Word positions of every document, for phrase queries. A position is the
+// index of a word in the document with stop words removed. The positions of
+// one term in one document are delta-encoded as base-128 varints, so a
+// typical position takes a single byte.
+class PositionalIndex {
+public:
+    // term_ids are the document's words in text order.
+    void AddDocument(int document_id, const std::vector<int>& term_ids);
+    void RemoveDocument(int document_id);
+
+    // Ascending positions of the term in the document, empty if it is absent.
+    std::vector<int> GetPositions(int document_id, int term_id) const;
+    // True if the terms occur one right after another somewhere in the document.
+    bool ContainsPhrase(int document_id, const std::vector<int>& term_ids) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    // Positions of term_ids[i] are data[offsets[i]] .. data[offsets[i + 1] - 1].
+    struct DocumentPositions {
+        std::vector<int> term_ids;
+        std::vector<std::uint32_t> offsets;
+        std::vector<std::uint8_t> data;
+    };
+
+    std::map<int, DocumentPositions> documents_;
+};
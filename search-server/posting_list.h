@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// Term frequencies are stored as double, so relevances are exact. With
+// SEARCH_SERVER_FAST_SCORING they are stored as float: posting lists shrink
+// by a third and the scoring loop reads half as many bytes, relevances move
+// by about 1e-7 of their value.
+#ifdef SEARCH_SERVER_FAST_SCORING
+using StoredTermFreq = float;
+#else
+using StoredTermFreq = double;
+#endif
+
+// Postings of one word: ascending document ids, their term frequencies and
+// their lengths in parallel arrays, so the scoring kernel can read the
+// frequencies of a block as one contiguous run and length-normalized rankings
+// need no lookup per posting. Iteration yields std::pair<int, double>.
+class PostingList {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<int, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const PostingList* postings, size_t index)
+            : postings_(postings)
+            , index_(index) {
+        }
+
+        value_type operator*() const {
+            return {postings_->document_ids_[index_], postings_->term_freqs_[index_]};
+        }
+
+        Iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++index_;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return index_ != other.index_;
+        }
+
+    private:
+        const PostingList* postings_;
+        size_t index_;
+    };
+
+    // Documents usually arrive with growing ids, which makes this an append.
+    void Insert(int document_id, double term_freq, int document_length) {
+        const auto position = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+        const auto index = position - document_ids_.begin();
+        if (position != document_ids_.end() && *position == document_id) {
+            term_freqs_[index] = static_cast<StoredTermFreq>(term_freq);
+            document_lengths_[index] = document_length;
+            return;
+        }
+        document_ids_.insert(position, document_id);
+        term_freqs_.insert(term_freqs_.begin() + index, static_cast<StoredTermFreq>(term_freq));
+        document_lengths_.insert(document_lengths_.begin() + index, document_length);
+    }
+
+    void Erase(int document_id) {
+        const auto position = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+        if (position == document_ids_.end() || *position != document_id) {
+            return;
+        }
+        const auto index = position - document_ids_.begin();
+        term_freqs_.erase(term_freqs_.begin() + index);
+        document_lengths_.erase(document_lengths_.begin() + index);
+        document_ids_.erase(position);
+    }
+
+    // Removes all listed documents in one compaction pass; the ids must be
+    // sorted in ascending order.
+    void EraseSorted(const std::vector<int>& sorted_document_ids) {
+        size_t kept = 0;
+        auto removed = sorted_document_ids.begin();
+        for (size_t i = 0; i < document_ids_.size(); ++i) {
+            while (removed != sorted_document_ids.end() && *removed < document_ids_[i]) {
+                ++removed;
+            }
+            if (removed != sorted_document_ids.end() && *removed == document_ids_[i]) {
+                continue;
+            }
+            document_ids_[kept] = document_ids_[i];
+            term_freqs_[kept] = term_freqs_[i];
+            document_lengths_[kept] = document_lengths_[i];
+            ++kept;
+        }
+        document_ids_.resize(kept);
+        term_freqs_.resize(kept);
+        document_lengths_.resize(kept);
+    }
+
+    const int* GetDocumentIds() const {
+        return document_ids_.data();
+    }
+
+    const StoredTermFreq* GetTermFreqs() const {
+        return term_freqs_.data();
+    }
+
+    // word counts of the documents without stop words
+    const int* GetDocumentLengths() const {
+        return document_lengths_.data();
+    }
+
+    Iterator begin() const {
+        return {this, 0};
+    }
+
+    Iterator end() const {
+        return {this, document_ids_.size()};
+    }
+
+    size_t size() const {
+        return document_ids_.size();
+    }
+
+    bool empty() const {
+        return document_ids_.empty();
+    }
+
+    size_t GetMemoryUsage() const {
+        return (document_ids_.capacity() + document_lengths_.capacity()) * sizeof(int)
+            + term_freqs_.capacity() * sizeof(StoredTermFreq);
+    }
+
+private:
+    std::vector<int> document_ids_;
+    std::vector<StoredTermFreq> term_freqs_;
+    std::vector<int> document_lengths_;
+};
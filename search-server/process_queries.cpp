@@ -7,24 +7,61 @@
 
 #include "document.h"
 #include "search_server.h"
+#include "task_scheduler.h"
 
 using namespace std;
 
+namespace {
+// Queries are packed into tasks of roughly this many postings. A query that
+// alone exceeds it runs as its own task and is split further into term-level
+// subtasks by the parallel FindTopDocuments.
+constexpr size_t TASK_COST = 1 << 14;
+}
+
 vector<vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const vector<string>& queries) {
     vector<vector<Document>> result(queries.size());
-    transform(
-        execution::par,
-        queries.begin(),
-        queries.end(),
-        result.begin(),
-        [&search_server](const string& query){
-            return search_server.FindTopDocuments(query);
+    auto& scheduler = TaskScheduler::Instance();
+
+    vector<size_t> costs(queries.size());
+    scheduler.ParallelFor(
+        queries.size(),
+        [&](size_t index) {
+            costs[index] = search_server.EstimateQueryCost(queries[index]);
+        });
+
+    // [first, last) ranges of query indices, one per task
+    vector<pair<size_t, size_t>> batches;
+    size_t batch_cost = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        if (batches.empty() || costs[i] >= TASK_COST || batch_cost + costs[i] > TASK_COST) {
+            batches.push_back({i, i});
+            batch_cost = 0;
+        }
+        batch_cost += costs[i];
+        batches.back().second = i + 1;
+    }
+
+    scheduler.ParallelFor(
+        batches.size(),
+        [&](size_t index) {
+            const auto [first, last] = batches[index];
+            for (size_t i = first; i < last; ++i) {
+                result[i] = costs[i] >= TASK_COST
+                    ? search_server.FindTopDocuments(execution::par, queries[i])
+                    : search_server.FindTopDocuments(queries[i]);
+            }
         });
     return result;
 }
 
+vector<vector<Document>> ProcessQueriesBatched(
+    const SearchServer& search_server,
+    const vector<string>& queries) {
+    return search_server.FindTopDocumentsBatch(queries);
+}
+
 vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const vector<string>& queries) {
@@ -12,4 +12,10 @@ std::vector<std::vector<Document>> ProcessQueries(
 
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+// Same results as ProcessQueries, but every posting list shared by several
+// queries is scanned once for the whole batch. Meant for large offline replays.
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "query_analytics.h"
+#include "string_processing.h"
+
+using namespace std;
+
+chrono::microseconds QueryAnalytics::Snapshot::GetLatencyQuantile(double quantile) const {
+    const uint64_t total = request_count;
+    if (total == 0) {
+        return chrono::microseconds(0);
+    }
+    const uint64_t rank = static_cast<uint64_t>(quantile * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+        seen += latency_histogram[i];
+        if (seen >= rank) {
+            return chrono::microseconds((uint64_t{2} << i) - 1);
+        }
+    }
+    return chrono::microseconds::max();
+}
+
+void QueryAnalytics::Record(string_view raw_query, size_t result_count, Clock::duration latency,
+                            Clock::time_point now) {
+    const int64_t minute = ToMinute(now);
+    const string_view query = raw_query.substr(0, MAX_TRACKED_QUERY_LENGTH);
+
+    lock_guard guard(mutex_);
+    Bucket& bucket = buckets_[minute % WINDOW_MINUTES];
+    if (bucket.minute != minute) {
+        bucket = Bucket{};
+        bucket.minute = minute;
+    }
+    ++bucket.request_count;
+    if (result_count == 0) {
+        ++bucket.no_result_count;
+    }
+    ++bucket.latency_histogram[ToLatencyBucket(latency)];
+
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+        ++bucket.sketch[row][ToSketchColumn(query, row)];
+    }
+    const uint64_t estimate = bucket.Estimate(query);
+    auto& heavy_hitters = bucket.heavy_hitters;
+    auto it = find_if(heavy_hitters.begin(), heavy_hitters.end(),
+                      [query](const HeavyHitter& hitter) {
+                          return hitter.query == query;
+                      });
+    if (it != heavy_hitters.end()) {
+        it->count = estimate;
+    } else if (heavy_hitters.size() < HEAVY_HITTER_COUNT) {
+        heavy_hitters.push_back({string{query}, estimate});
+    } else {
+        auto least = min_element(heavy_hitters.begin(), heavy_hitters.end(),
+                                 [](const HeavyHitter& lhs, const HeavyHitter& rhs) {
+                                     return lhs.count < rhs.count;
+                                 });
+        if (least->count < estimate) {
+            least->query.assign(query);
+            least->count = estimate;
+        }
+    }
+}
+
+QueryAnalytics::Snapshot QueryAnalytics::GetSnapshot(Clock::time_point now) const {
+    const int64_t current_minute = ToMinute(now);
+    Snapshot snapshot;
+    map<string, uint64_t> candidates;
+
+    lock_guard guard(mutex_);
+    for (const Bucket& bucket : buckets_) {
+        if (bucket.minute < 0 || current_minute - bucket.minute >= static_cast<int64_t>(WINDOW_MINUTES)) {
+            continue;
+        }
+        snapshot.request_count += bucket.request_count;
+        snapshot.no_result_count += bucket.no_result_count;
+        for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+            snapshot.latency_histogram[i] += bucket.latency_histogram[i];
+        }
+        for (const auto& hitter : bucket.heavy_hitters) {
+            candidates.emplace(hitter.query, 0);
+        }
+    }
+    // a query may be a heavy hitter in one minute only, so its window count
+    // is estimated from the sketches of all live buckets
+    for (auto& [query, count] : candidates) {
+        for (const Bucket& bucket : buckets_) {
+            if (bucket.minute >= 0 && current_minute - bucket.minute < static_cast<int64_t>(WINDOW_MINUTES)) {
+                count += bucket.Estimate(query);
+            }
+        }
+    }
+
+    snapshot.heavy_hitters.assign(candidates.begin(), candidates.end());
+    sort(snapshot.heavy_hitters.begin(), snapshot.heavy_hitters.end(),
+         [](const auto& lhs, const auto& rhs) {
+             return lhs.second > rhs.second;
+         });
+    if (snapshot.heavy_hitters.size() > HEAVY_HITTER_COUNT) {
+        snapshot.heavy_hitters.resize(HEAVY_HITTER_COUNT);
+    }
+    return snapshot;
+}
+
+uint64_t QueryAnalytics::Bucket::Estimate(string_view query) const {
+    uint64_t estimate = UINT64_MAX;
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+        estimate = min<uint64_t>(estimate, sketch[row][ToSketchColumn(query, row)]);
+    }
+    return estimate;
+}
+
+int64_t QueryAnalytics::ToMinute(Clock::time_point time) {
+    return chrono::duration_cast<chrono::minutes>(time.time_since_epoch()).count();
+}
+
+size_t QueryAnalytics::ToLatencyBucket(Clock::duration latency) {
+    const auto microseconds = chrono::duration_cast<chrono::microseconds>(latency).count();
+    uint64_t value = static_cast<uint64_t>(max<int64_t>(microseconds, 0)) + 1;
+    size_t bucket = 0;
+    while (value > 1 && bucket + 1 < LATENCY_BUCKET_COUNT) {
+        value >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+size_t QueryAnalytics::ToSketchColumn(string_view query, size_t row) {
+    return HashWord(query, 0x9e3779b97f4a7c15ULL * (row + 1)) % SKETCH_WIDTH;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Rolling statistics of search requests over the last WINDOW_MINUTES minutes.
+// Every minute has its own bucket in a ring buffer: request counts, a
+// power-of-two latency histogram and the most frequent queries, found with a
+// count-min sketch and a small top list. Memory does not depend on the number
+// or the variety of queries. All methods are thread-safe.
+class QueryAnalytics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t WINDOW_MINUTES = 60;
+    // bucket i counts latencies in [2^i - 1, 2^(i+1) - 1) microseconds
+    static constexpr size_t LATENCY_BUCKET_COUNT = 32;
+    static constexpr size_t HEAVY_HITTER_COUNT = 16;
+    static constexpr size_t SKETCH_DEPTH = 4;
+    static constexpr size_t SKETCH_WIDTH = 256;
+    // longer queries are tracked by their prefix
+    static constexpr size_t MAX_TRACKED_QUERY_LENGTH = 64;
+
+    struct Snapshot {
+        uint64_t request_count = 0;
+        uint64_t no_result_count = 0;
+        std::array<uint64_t, LATENCY_BUCKET_COUNT> latency_histogram{};
+        // estimated counts, most frequent first
+        std::vector<std::pair<std::string, uint64_t>> heavy_hitters;
+
+        // upper bound of the histogram bucket holding the given quantile
+        std::chrono::microseconds GetLatencyQuantile(double quantile) const;
+    };
+
+    void Record(std::string_view raw_query, size_t result_count, Clock::duration latency,
+        Clock::time_point now = Clock::now());
+    Snapshot GetSnapshot(Clock::time_point now = Clock::now()) const;
+
+private:
+    struct HeavyHitter {
+        std::string query;
+        uint64_t count = 0;
+    };
+
+    struct Bucket {
+        int64_t minute = -1;
+        uint64_t request_count = 0;
+        uint64_t no_result_count = 0;
+        std::array<uint64_t, LATENCY_BUCKET_COUNT> latency_histogram{};
+        std::array<std::array<uint32_t, SKETCH_WIDTH>, SKETCH_DEPTH> sketch{};
+        std::vector<HeavyHitter> heavy_hitters;
+
+        uint64_t Estimate(std::string_view query) const;
+    };
+
+    static int64_t ToMinute(Clock::time_point time);
+    static size_t ToLatencyBucket(Clock::duration latency);
+    static size_t ToSketchColumn(std::string_view query, size_t row);
+
+    mutable std::mutex mutex_;
+    std::array<Bucket, WINDOW_MINUTES> buckets_;
+};
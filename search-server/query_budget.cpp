@@ -0,0 +1,28 @@
+#include <atomic>
+#include <memory>
+
+#include "query_budget.h"
+
+using namespace std;
+
+CancellationToken::CancellationToken()
+    : cancelled_(make_shared<atomic<bool>>(false)) {
+}
+
+void CancellationToken::Cancel() {
+    cancelled_->store(true, memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const {
+    return cancelled_->load(memory_order_relaxed);
+}
+
+QueryStatus QueryBudget::Check() const {
+    if (token.IsCancelled()) {
+        return QueryStatus::CANCELLED;
+    }
+    if (Clock::now() >= deadline) {
+        return QueryStatus::TIMEOUT;
+    }
+    return QueryStatus::COMPLETE;
+}
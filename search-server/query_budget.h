@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "document.h"
+
+enum class QueryStatus {
+    COMPLETE,
+    TIMEOUT,
+    CANCELLED,
+};
+
+// Shared cancellation flag: copies of a token observe the same state, so the
+// caller keeps one copy and hands another to the running query.
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void Cancel();
+    bool IsCancelled() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+struct QueryBudget {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point deadline = Clock::time_point::max();
+    CancellationToken token;
+
+    QueryStatus Check() const;
+};
+
+// Top documents of an async query. Unless status is COMPLETE the documents are
+// the best ones found among the postings scanned before the query stopped.
+struct SearchResult {
+    std::vector<Document> documents;
+    QueryStatus status = QueryStatus::COMPLETE;
+};
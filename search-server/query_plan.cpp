@@ -0,0 +1,25 @@
+#include <iostream>
+#include <string>
+
+#include "query_plan.h"
+
+using namespace std;
+
+ostream& operator<<(ostream& output, QueryExecution execution) {
+    switch (execution) {
+        case QueryExecution::SEQUENTIAL: return output << "SEQUENTIAL"s;
+        case QueryExecution::PARALLEL: return output << "PARALLEL"s;
+        case QueryExecution::PRUNED: return output << "PRUNED"s;
+    }
+    return output;
+}
+
+ostream& operator<<(ostream& output, const QueryPlan& plan) {
+    output << "{ execution = "s << plan.execution << ", estimated_cost = "s << plan.estimated_cost;
+    for (const auto& [words, sign] : {pair{&plan.plus_words, "+"s}, pair{&plan.minus_words, "-"s}}) {
+        for (const auto& [word, posting_count] : *words) {
+            output << ", "s << sign << word << " = "s << posting_count;
+        }
+    }
+    return output << " }"s;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Execution policy tag: FindTopDocuments(adaptive_execution, raw_query)
+// lets the query planner choose how to run the query.
+struct AdaptiveExecutionPolicy {
+};
+
+inline constexpr AdaptiveExecutionPolicy adaptive_execution{};
+
+enum class QueryExecution {
+    // words one after another on the calling thread
+    SEQUENTIAL,
+    // words scored on the task scheduler, merged on the calling thread
+    PARALLEL,
+    // the candidates are fixed first by phrases and minus-words, only their
+    // postings are scored
+    PRUNED,
+};
+
+// What SearchServer::PlanQuery decided, for debugging and tests. Relevances
+// do not depend on the execution chosen.
+struct QueryPlan {
+    QueryExecution execution = QueryExecution::SEQUENTIAL;
+    // plus-word postings the plan reads
+    size_t estimated_cost = 0;
+    // plus-words with their posting list lengths in the order they are
+    // scored, rarest first
+    std::vector<std::pair<std::string, size_t>> plus_words;
+    // minus-words, rarest first; they narrow the candidates before scoring
+    // in PRUNED and are excluded after scoring otherwise
+    std::vector<std::pair<std::string, size_t>> minus_words;
+};
+
+std::ostream& operator<<(std::ostream& output, QueryExecution execution);
+std::ostream& operator<<(std::ostream& output, const QueryPlan& plan);
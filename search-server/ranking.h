@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+// Ranking policies for SearchServer::FindTopDocuments. The relevance of a
+// document is the sum over matched query words of
+//     ComputeInverseDocumentFreq(...) * ComputeTermWeight(...),
+// where term_freq is the share of the document's words equal to the query
+// word. Policies are stateless and chosen at compile time, so the scoring
+// loop of each one is compiled separately and carries no runtime branch.
+
+// Classic TF-IDF, the default.
+struct TfIdfRanking {
+    static constexpr bool USES_DOCUMENT_LENGTH = false;
+
+    static double ComputeInverseDocumentFreq(int document_count, size_t document_freq) {
+        return std::log(document_count * 1.0 / document_freq);
+    }
+
+    static double ComputeTermWeight(double term_freq, int /*document_length*/,
+                                    double /*average_document_length*/) {
+        return term_freq;
+    }
+};
+
+// Okapi BM25: term frequency saturates and is normalized by the document
+// length relative to the average one.
+struct Bm25Ranking {
+    static constexpr bool USES_DOCUMENT_LENGTH = true;
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    // The "+ 1" variant, which stays positive for words found in most documents.
+    static double ComputeInverseDocumentFreq(int document_count, size_t document_freq) {
+        const double freq = static_cast<double>(document_freq);
+        return std::log((document_count - freq + 0.5) / (freq + 0.5) + 1.0);
+    }
+
+    static double ComputeTermWeight(double term_freq, int document_length, double average_document_length) {
+        const double occurrence_count = term_freq * document_length;
+        return occurrence_count * (K1 + 1.0)
+            / (occurrence_count + K1 * (1.0 - B + B * document_length / average_document_length));
+    }
+};
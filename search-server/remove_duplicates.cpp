@@ -1,30 +1,115 @@
-#include <set>
-#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <execution>
 #include <iostream>
 #include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
 
 #include "remove_duplicates.h"
 #include "search_server.h"
+#include "string_processing.h"
 
 using namespace std;
 
-void RemoveDuplicates(SearchServer& search_server) {
-    set<set<string_view>> document_word_sets;
-    vector<int> marked_for_deletion;
-    for (int id: search_server) {
-        auto word_freqs_in_document = search_server.GetWordFrequencies(id);
-        set<string_view> document_word_set;
-        for (auto& [word, freq]: word_freqs_in_document) {
-            document_word_set.insert(word);
+namespace {
+
+struct Fingerprint {
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    bool operator<(const Fingerprint& other) const {
+        return tie(high, low) < tie(other.high, other.low);
+    }
+    bool operator==(const Fingerprint& other) const {
+        return high == other.high && low == other.low;
+    }
+};
+
+// Terms of a document are sorted by id, so equal word sets produce equal id
+// sequences and an order-dependent combination is enough.
+Fingerprint ComputeFingerprint(const WordFrequencies& word_freqs) {
+    Fingerprint fingerprint{0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL};
+    for (auto it = word_freqs.begin(); it != word_freqs.end(); ++it) {
+        const uint64_t term_id = static_cast<uint64_t>(it.GetTermId());
+        fingerprint.high = MixHash(fingerprint.high ^ MixHash(term_id + 0xcbf29ce484222325ULL));
+        fingerprint.low = MixHash(fingerprint.low + MixHash(term_id ^ 0x84222325cbf29ce4ULL));
+    }
+    return fingerprint;
+}
+
+}
+
+DuplicatesReport RemoveDuplicates(SearchServer& search_server) {
+    const vector<int> ids(search_server.begin(), search_server.end());
+    vector<pair<Fingerprint, int>> fingerprints(ids.size());
+    transform(
+        execution::par,
+        ids.begin(),
+        ids.end(),
+        fingerprints.begin(),
+        [&search_server](int id) {
+            return pair{ComputeFingerprint(search_server.GetWordFrequencies(id)), id};
+        });
+    sort(execution::par, fingerprints.begin(), fingerprints.end());
+
+    DuplicatesReport report;
+    vector<int> kept_ids;
+    for (auto group_begin = fingerprints.begin(); group_begin != fingerprints.end();) {
+        const auto group_end = find_if(group_begin, fingerprints.end(),
+                                       [&group_begin](const auto& entry) {
+                                           return !(entry.first == group_begin->first);
+                                       });
+        kept_ids.clear();
+        for (auto it = group_begin; it != group_end; ++it) {
+            const auto word_freqs = search_server.GetWordFrequencies(it->second);
+            const bool is_duplicate = any_of(
+                kept_ids.begin(), kept_ids.end(),
+                [&](int kept_id) {
+                    return search_server.GetWordFrequencies(kept_id).HasSameTerms(word_freqs);
+                });
+            if (is_duplicate) {
+                report.removed_ids.push_back(it->second);
+            } else {
+                if (!kept_ids.empty()) {
+                    ++report.fingerprint_collisions;
+                }
+                kept_ids.push_back(it->second);
+            }
+        }
+        group_begin = group_end;
+    }
+
+    sort(report.removed_ids.begin(), report.removed_ids.end());
+    search_server.RemoveDocuments(report.removed_ids);
+    return report;
+}
+
+DuplicatesReport RemoveNearDuplicates(SearchServer& search_server) {
+    DuplicatesReport report;
+    set<int> removed_ids;
+    for (int id : search_server) {
+        if (removed_ids.count(id) > 0) {
+            continue;
         }
-        if (document_word_sets.count(document_word_set) != 0) {
-            marked_for_deletion.push_back(id);
-            cout << "Found duplicate document id "s << id << endl;
-        } else {
-            document_word_sets.insert(document_word_set);
+        for (int near_duplicate_id : search_server.FindNearDuplicates(id)) {
+            if (near_duplicate_id > id) {
+                removed_ids.insert(near_duplicate_id);
+            }
         }
     }
-   for (int id: marked_for_deletion) {
-            search_server.RemoveDocument(id);
-   }
-}
\ No newline at end of file
+
+    report.removed_ids.assign(removed_ids.begin(), removed_ids.end());
+    search_server.RemoveDocuments(report.removed_ids);
+    return report;
+}
+
+ostream& operator<<(ostream& output, const DuplicatesReport& report) {
+    for (int id : report.removed_ids) {
+        output << "Found duplicate document id "s << id << endl;
+    }
+    return output;
+}
@@ -1,5 +1,22 @@
 #pragma once
 
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+struct DuplicatesReport {
+    // ids of removed documents in ascending order; of every group of documents
+    // with the same word set the one with the smallest id is kept
+    std::vector<int> removed_ids;
+    // fingerprint matches that turned out to be different word sets
+    size_t fingerprint_collisions = 0;
+};
+
+DuplicatesReport RemoveDuplicates(SearchServer& search_server);
+// Collapses clusters of near-duplicate documents to their smallest id.
+// Requires SearchServer::EnableNearDuplicateDetection.
+DuplicatesReport RemoveNearDuplicates(SearchServer& search_server);
+
+std::ostream& operator<<(std::ostream& output, const DuplicatesReport& report);
@@ -1,6 +1,5 @@
 #include <vector>
 #include <string>
-#include <deque>
 
 #include "request_queue.h"
 #include "search_server.h"
@@ -9,7 +8,8 @@ using namespace std;
 
 RequestQueue::RequestQueue(const SearchServer& search_server)
     :server_(search_server)
-    ,current_time_(0) {
+    ,current_time_(0)
+    ,no_result_count_(0) {
 }
     
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
@@ -25,5 +25,5 @@ vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
 }
     
 int RequestQueue::GetNoResultRequests() const {
-    return requests_.size();
+    return no_result_count_;
 }
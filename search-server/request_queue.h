@@ -1,7 +1,7 @@
 #pragma once
+#include <array>
 #include <vector>
 #include <string>
-#include <deque>
 
 #include "search_server.h"
 
@@ -11,16 +11,16 @@ public:
     
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-        if (!requests_.empty() && min_in_day_ <= current_time_ - requests_.front().timestamp) {
-            requests_.pop_front();
-        }
-      
         auto requested_documents = server_.FindTopDocuments(raw_query, document_predicate);
-        if (requested_documents.empty()) {
-            requests_.push_back(QueryResult{raw_query, current_time_});
-        } 
         
-        ++current_time_;
+        // the slot of the request that has just left the window is reused
+        bool& is_no_result = no_result_flags_[current_time_];
+        no_result_count_ -= is_no_result;
+        is_no_result = requested_documents.empty();
+        no_result_count_ += is_no_result;
+        
+        // wraps around the window instead of counting up to overflow
+        current_time_ = (current_time_ + 1) % min_in_day_;
         return requested_documents;
     }
     
@@ -29,12 +29,11 @@ public:
     int GetNoResultRequests() const;
     
 private:
-    struct QueryResult {
-        std::string query_text;
-        int timestamp;
-    };
-    std::deque<QueryResult> requests_;
     const static int min_in_day_ = 1440;
+    // whether each of the last min_in_day_ requests found nothing
+    std::array<bool, min_in_day_> no_result_flags_{};
     const SearchServer& server_;
+    // slot of the next request in no_result_flags_
     int current_time_;
+    int no_result_count_;
 };
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "document.h"
+
+class SearchServer;
+
+// Continuation token of paged search. It records the last document returned,
+// so the next page is selected among the documents ranked after it. Pass it
+// back unchanged; a default-constructed cursor starts from the first page.
+class PageCursor {
+public:
+    PageCursor() = default;
+
+    bool IsEnd() const {
+        return is_end_;
+    }
+
+private:
+    friend class SearchServer;
+
+    bool is_start_ = true;
+    bool is_end_ = false;
+    double relevance_ = 0.0;
+    int rating_ = 0;
+    int id_ = 0;
+};
+
+struct ResultPage {
+    std::vector<Document> documents;
+    PageCursor next_page;
+};
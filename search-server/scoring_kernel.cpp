@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+#include "scoring_kernel.h"
+
+using namespace std;
+
+void ScorePostingBlock(const StoredTermFreq* __restrict term_freqs, size_t count, double inverse_document_freq,
+                       double* __restrict scores) {
+    for (size_t i = 0; i < count; ++i) {
+        scores[i] = term_freqs[i] * inverse_document_freq;
+    }
+}
+
+void AccumulateScores(const int* document_ids, const double* scores, size_t count,
+                      ScoreAccumulator& accumulator, ScoreAccumulator& buffer) {
+    if (count == 0) {
+        return;
+    }
+    buffer.clear();
+    buffer.reserve(accumulator.size() + count);
+    size_t i = 0;
+    size_t j = 0;
+    while (i < accumulator.size() && j < count) {
+        if (accumulator[i].first < document_ids[j]) {
+            buffer.push_back(accumulator[i++]);
+        } else if (document_ids[j] < accumulator[i].first) {
+            buffer.push_back({document_ids[j], scores[j]});
+            ++j;
+        } else {
+            buffer.push_back({document_ids[j], accumulator[i++].second + scores[j]});
+            ++j;
+        }
+    }
+    buffer.insert(buffer.end(), accumulator.begin() + i, accumulator.end());
+    for (; j < count; ++j) {
+        buffer.push_back({document_ids[j], scores[j]});
+    }
+    accumulator.swap(buffer);
+}
+
+void UnionScores(const vector<ScoredPostings>& lists, vector<int>& document_ids, vector<double>& scores) {
+    document_ids.clear();
+    scores.clear();
+    // (document id, list index) of the next posting of every list
+    using Head = pair<int, size_t>;
+    priority_queue<Head, vector<Head>, greater<Head>> heads;
+    vector<size_t> positions(lists.size(), 0);
+    for (size_t i = 0; i < lists.size(); ++i) {
+        if (lists[i].size > 0) {
+            heads.push({lists[i].document_ids[0], i});
+        }
+    }
+    while (!heads.empty()) {
+        const auto [document_id, list] = heads.top();
+        heads.pop();
+        const double score = lists[list].scores[positions[list]];
+        if (!document_ids.empty() && document_ids.back() == document_id) {
+            scores.back() += score;
+        } else {
+            document_ids.push_back(document_id);
+            scores.push_back(score);
+        }
+        if (++positions[list] < lists[list].size) {
+            heads.push({lists[list].document_ids[positions[list]], list});
+        }
+    }
+}
+
+void ExcludeDocuments(const PostingList& postings, ScoreAccumulator& accumulator) {
+    const int* const excluded_begin = postings.GetDocumentIds();
+    const int* const excluded_end = excluded_begin + postings.size();
+    const int* excluded = excluded_begin;
+    accumulator.erase(
+        remove_if(accumulator.begin(), accumulator.end(),
+                  [&excluded, excluded_end](const pair<int, double>& entry) {
+                      excluded = lower_bound(excluded, excluded_end, entry.first);
+                      return excluded != excluded_end && *excluded == entry.first;
+                  }),
+        accumulator.end());
+}
+
+void KeepDocuments(const vector<int>& sorted_document_ids, ScoreAccumulator& accumulator) {
+    auto kept = sorted_document_ids.begin();
+    accumulator.erase(
+        remove_if(accumulator.begin(), accumulator.end(),
+                  [&kept, &sorted_document_ids](const pair<int, double>& entry) {
+                      kept = lower_bound(kept, sorted_document_ids.end(), entry.first);
+                      return kept == sorted_document_ids.end() || *kept != entry.first;
+                  }),
+        accumulator.end());
+}
+
+void IntersectDocuments(const PostingList& postings, vector<int>& candidates) {
+    const int* const ids = postings.GetDocumentIds();
+    const size_t size = postings.size();
+    const bool gallop = candidates.size() * GALLOP_MIN_RATIO < size;
+    size_t position = 0;
+    size_t kept = 0;
+    for (const int document_id : candidates) {
+        if (gallop) {
+            size_t offset = 1;
+            while (position + offset < size && ids[position + offset] < document_id) {
+                offset *= 2;
+            }
+            position = lower_bound(ids + position + offset / 2, ids + min(position + offset + 1, size), document_id)
+                - ids;
+        } else {
+            while (position + INTERSECT_BLOCK_SIZE <= size && ids[position + INTERSECT_BLOCK_SIZE - 1] < document_id) {
+                position += INTERSECT_BLOCK_SIZE;
+            }
+            // branch-free count of the smaller ids within the block
+            const size_t block_end = min(position + INTERSECT_BLOCK_SIZE, size);
+            size_t smaller_count = 0;
+            for (size_t i = position; i < block_end; ++i) {
+                smaller_count += ids[i] < document_id;
+            }
+            position += smaller_count;
+        }
+        if (position == size) {
+            break;
+        }
+        if (ids[position] == document_id) {
+            candidates[kept++] = document_id;
+        }
+    }
+    candidates.resize(kept);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "posting_list.h"
+
+const size_t INTERSECT_BLOCK_SIZE = 16;
+// galloping pays off once the list is this many times longer than the candidates
+const size_t GALLOP_MIN_RATIO = 32;
+
+// Relevances of one query: (document id, relevance) pairs sorted by id.
+using ScoreAccumulator = std::vector<std::pair<int, double>>;
+
+// scores[i] = term_freqs[i] * inverse_document_freq. A plain loop over
+// non-aliasing arrays that the compiler vectorizes: SSE2 by default,
+// AVX2 or AVX-512 when built with SEARCH_SERVER_NATIVE_ARCH.
+void ScorePostingBlock(const StoredTermFreq* term_freqs, size_t count, double inverse_document_freq,
+                       double* scores);
+
+// Adds scored postings with ascending document ids to the accumulator in one
+// linear merge. Every relevance is summed in the order the words are added,
+// so the result does not depend on how postings are split into blocks.
+// buffer is scratch space that callers reuse between calls.
+void AccumulateScores(const int* document_ids, const double* scores, size_t count,
+                      ScoreAccumulator& accumulator, ScoreAccumulator& buffer);
+
+// Scores of one posting list: scores[i] belongs to document_ids[i], ids ascend.
+struct ScoredPostings {
+    const int* document_ids;
+    const double* scores;
+    size_t size;
+};
+
+// Merges several scored lists into one with ascending ids in a single heap
+// pass. Scores of a document present in several lists are summed in list
+// order.
+void UnionScores(const std::vector<ScoredPostings>& lists, std::vector<int>& document_ids,
+                 std::vector<double>& scores);
+
+// Removes all documents of the posting list from the accumulator.
+void ExcludeDocuments(const PostingList& postings, ScoreAccumulator& accumulator);
+
+// Keeps only the listed documents; the ids must be sorted in ascending order.
+void KeepDocuments(const std::vector<int>& sorted_document_ids, ScoreAccumulator& accumulator);
+
+// Keeps the candidates present in the posting list; both ascend. When the
+// list is much longer than the candidates it is galloped through, otherwise
+// candidates are compared with blocks of INTERSECT_BLOCK_SIZE ids in a loop
+// the compiler vectorizes.
+void IntersectDocuments(const PostingList& postings, std::vector<int>& candidates);
@@ -11,10 +11,12 @@
 #include <execution>
 #include <iostream>
 #include <string_view>
+#include <tuple>
 
 #include "search_server.h"
 #include "log_duration.h"
 #include "process_queries.h"
+#include "metrics.h"
 
 using namespace std;
 
@@ -28,31 +30,210 @@ SearchServer::SearchServer(string_view stop_words)
     : SearchServer(SplitIntoWords(string{stop_words})) {
 }
 
+// The text is tokenized before the write side of the index is taken, so
+// writers keep queries out only while they index. Inside, writers hold locks
+// around shared structures: the document table to claim an id and to publish
+// the document, the dictionary to resolve terms, and one posting stripe per
+// term while appending to its list.
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
                                const vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
-        throw invalid_argument("Invalid document_id"s);
+    METRICS_TIMER(timer);
+    const auto words = SplitIntoWordsNoStop(document);
+    METRICS_CHECKPOINT(timer, Metric::DOCUMENT_TOKENIZE);
+    unique_lock index_guard(writer_sync_.index.writers);
+    ClaimDocumentId(document_id, DocumentMetadata{ComputeAverageRating(ratings), status});
+    string_view text;
+    try {
+        lock_guard guard(writer_sync_.documents);
+        text = doc_storage_.emplace_back(document);
+    } catch (...) {
+        ReleaseDocumentId(document_id);
+        throw;
     }
-    
-    doc_storage_.emplace_back(string{document});
-    const auto words = SplitIntoWordsNoStop(doc_storage_.back());
+    // the words are moved over to the stored copy of the text
+    vector<string_view> stored_words;
+    stored_words.reserve(words.size());
+    for (auto word : words) {
+        stored_words.push_back(text.substr(word.data() - document.data(), word.size()));
+    }
+    IndexDocument(document_id, text, stored_words, move(index_guard));
+    METRICS_CHECKPOINT(timer, Metric::DOCUMENT_INDEX);
+}
+
+int SearchServer::AddDocument(string_view document, DocumentStatus status, const vector<int>& ratings) {
+    const int document_id = writer_sync_.next_document_id.fetch_add(1, memory_order_relaxed);
+    AddDocument(document_id, document, status, ratings);
+    return document_id;
+}
+
+vector<string_view> SearchServer::TokenizeDocument(string_view document) const {
+    return SplitIntoWordsNoStop(document);
+}
+
+void SearchServer::AddTokenizedDocument(int document_id, string_view document, const vector<string_view>& words,
+                                        DocumentStatus status, const vector<int>& ratings,
+                                        shared_ptr<const void> storage) {
+    METRICS_TIMER(timer);
+    unique_lock index_guard(writer_sync_.index.writers);
+    ClaimDocumentId(document_id, DocumentMetadata{ComputeAverageRating(ratings), status});
+    {
+        lock_guard guard(writer_sync_.documents);
+        if (pinned_storage_.empty() || pinned_storage_.back() != storage) {
+            pinned_storage_.push_back(move(storage));
+        }
+    }
+    IndexDocument(document_id, document, words, move(index_guard));
+    METRICS_CHECKPOINT(timer, Metric::DOCUMENT_INDEX);
+}
+
+// The id is taken by a placeholder entry, so two writers cannot add the same
+// document, and ids handed out by AddDocument without an id stay above it.
+// Queries never see the placeholder: it is filled in before the write side
+// of the index is released.
+void SearchServer::ClaimDocumentId(int document_id, DocumentMetadata metadata) {
+    {
+        lock_guard guard(writer_sync_.documents);
+        if ((document_id < 0) || !documents_.try_emplace(document_id, metadata, 0, string_view{}).second) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+    }
+    int next_id = writer_sync_.next_document_id.load(memory_order_relaxed);
+    while (next_id <= document_id
+           && !writer_sync_.next_document_id.compare_exchange_weak(next_id, document_id + 1, memory_order_relaxed)) {
+    }
+}
 
+void SearchServer::ReleaseDocumentId(int document_id) {
+    lock_guard guard(writer_sync_.documents);
+    documents_.erase(document_id);
+}
+
+// The write side of the index is released before the callbacks, which may
+// run queries.
+void SearchServer::IndexDocument(int document_id, string_view document, const vector<string_view>& words,
+                                 unique_lock<PhaseLock::Side> index_guard) {
+    vector<int> term_ids;
+    term_ids.reserve(words.size());
+    {
+        lock_guard guard(writer_sync_.dictionary);
+        for (auto word : words) {
+            term_ids.push_back(dictionary_.GetOrAdd(word));
+        }
+    }
+    // the positional index needs the ids in text order
+    vector<int> text_term_ids;
+    if (positional_index_) {
+        text_term_ids = term_ids;
+    }
+    sort(term_ids.begin(), term_ids.end());
+
+    // tf is accumulated one occurrence at a time, exactly as it always was,
+    // so relevances do not change by a single bit
     const double inv_word_count = 1.0 / words.size();
-    for (auto word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][word] += inv_word_count;
+    vector<TermFrequency> document_terms;
+    for (auto it = term_ids.begin(); it != term_ids.end();) {
+        const int term_id = *it;
+        double term_freq = 0.0;
+        for (; it != term_ids.end() && *it == term_id; ++it) {
+            term_freq += inv_word_count;
+        }
+        document_terms.push_back({term_id, term_freq});
+    }
+
+    // map nodes never move, so the lists can be filled after the lock is gone
+    vector<PostingList*> postings(document_terms.size());
+    {
+        lock_guard guard(writer_sync_.dictionary);
+        for (size_t i = 0; i < document_terms.size(); ++i) {
+            postings[i] = &word_to_document_freqs_[dictionary_.GetTerm(document_terms[i].term_id)];
+        }
+    }
+    for (size_t i = 0; i < document_terms.size(); ++i) {
+        lock_guard guard(writer_sync_.postings[document_terms[i].term_id % POSTING_LOCK_STRIPES]);
+        postings[i]->Insert(document_id, document_terms[i].freq, static_cast<int>(words.size()));
+    }
+
+    DocumentStatus status;
+    vector<int> near_duplicates;
+    {
+        lock_guard guard(writer_sync_.documents);
+        document_to_terms_[document_id] = move(document_terms);
+        total_word_count_ += words.size();
+        auto& document_data = documents_.at(document_id);
+        document_data.word_count = static_cast<int>(words.size());
+        document_data.text = document;
+        status = document_data.GetMetadata().status;
+        document_ids_.insert(document_id);
+        if (positional_index_) {
+            positional_index_->AddDocument(document_id, text_term_ids);
+        }
+        if (near_duplicate_index_) {
+            near_duplicates = near_duplicate_index_->AddDocument(document_id, words);
+        }
+    }
+    // callbacks run with no lock held
+    index_guard.unlock();
+    if (!near_duplicates.empty() && near_duplicate_callback_) {
+        near_duplicate_callback_(document_id, near_duplicates);
+    }
+    standing_queries_.Percolate(document_id, words, status);
+}
+
+// Concurrent writers may be inserting into the document table, so the lookup
+// takes its lock; the node stays put afterwards and the metadata itself is
+// changed lock-free.
+atomic<SearchServer::DocumentMetadata>& SearchServer::FindDocumentMetadata(int document_id) {
+    lock_guard guard(writer_sync_.documents);
+    const auto document = documents_.find(document_id);
+    if (document == documents_.end()) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    return document->second.metadata;
+}
+
+void SearchServer::UpdateDocumentStatus(int document_id, DocumentStatus status) {
+    auto& metadata = FindDocumentMetadata(document_id);
+    auto current = metadata.load(memory_order_relaxed);
+    // a concurrent rating update must not be lost
+    while (!metadata.compare_exchange_weak(current, {current.rating, status}, memory_order_relaxed)) {
+    }
+}
+
+void SearchServer::UpdateDocumentRating(int document_id, const vector<int>& ratings) {
+    const int rating = ComputeAverageRating(ratings);
+    auto& metadata = FindDocumentMetadata(document_id);
+    auto current = metadata.load(memory_order_relaxed);
+    while (!metadata.compare_exchange_weak(current, {rating, current.status}, memory_order_relaxed)) {
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
-    document_ids_.insert(document_id);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    for (auto& [word, freq]: document_to_word_freqs_[document_id]) {
-            word_to_document_freqs_.at(word).erase(document_id);
+    const auto document_terms = document_to_terms_.find(document_id);
+    if (document_terms == document_to_terms_.end()) {
+        return;
+    }
+    for (const auto [term_id, freq] : document_terms->second) {
+        const auto postings = word_to_document_freqs_.find(dictionary_.GetTerm(term_id));
+        postings->second.Erase(document_id);
+        if (postings->second.empty()) {
+            word_to_document_freqs_.erase(postings);
+        }
     }
-    document_to_word_freqs_.erase(document_id);
+    ForgetDocument(document_id);
+}
+
+// Drops everything but the postings, which the callers have already erased.
+void SearchServer::ForgetDocument(int document_id) {
+    document_to_terms_.erase(document_id);
+    total_word_count_ -= documents_.at(document_id).word_count;
     documents_.erase(document_id);
     document_ids_.erase(document_id);
+    if (near_duplicate_index_) {
+        near_duplicate_index_->RemoveDocument(document_id);
+    }
+    if (positional_index_) {
+        positional_index_->RemoveDocument(document_id);
+    }
 }
 
 void SearchServer::RemoveDocument(
@@ -62,25 +243,70 @@ void SearchServer::RemoveDocument(
 }
 
 void SearchServer::RemoveDocument(execution::parallel_policy policy, int document_id) {
-    vector<string_view> words;
-    words.reserve(document_to_word_freqs_[document_id].size());
-    transform(
-        document_to_word_freqs_[document_id].begin(),
-        document_to_word_freqs_[document_id].end(),
-        back_inserter(words),
-        [](const auto& entry) {
-            return entry.first;
-        });
-    for_each(
-        policy,
-        words.begin(),
-        words.end(),
-        [document_id, this](auto str) {
-                word_to_document_freqs_.at(str).erase(document_id);
+    RemoveDocuments({document_id});
+}
+
+void SearchServer::RemoveDocuments(vector<int> document_ids) {
+    sort(document_ids.begin(), document_ids.end());
+    document_ids.erase(unique(document_ids.begin(), document_ids.end()), document_ids.end());
+    document_ids.erase(
+        remove_if(document_ids.begin(), document_ids.end(),
+                  [this](int document_id) {
+                      return documents_.count(document_id) == 0;
+                  }),
+        document_ids.end());
+    if (document_ids.empty()) {
+        return;
+    }
+
+    vector<pair<int, int>> postings;
+    for (int document_id : document_ids) {
+        for (const auto [term_id, freq] : document_to_terms_.at(document_id)) {
+            postings.push_back({term_id, document_id});
+        }
+    }
+    sort(execution::par, postings.begin(), postings.end());
+
+    // Each group holds all postings of one word with ascending document ids.
+    struct WordGroup {
+        PostingList* documents;
+        size_t begin;
+        size_t end;
+    };
+    vector<WordGroup> groups;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        if (groups.empty() || postings[i].first != postings[groups.back().begin].first) {
+            groups.push_back({&word_to_document_freqs_.at(dictionary_.GetTerm(postings[i].first)), i, i});
+        }
+        groups.back().end = i + 1;
+    }
+
+    // Every posting list is compacted once, whatever share of it goes away.
+    auto& scheduler = TaskScheduler::Instance();
+    const size_t chunk_count = min(groups.size(), scheduler.GetThreadCount() * 4);
+    scheduler.ParallelFor(
+        chunk_count,
+        [&](size_t chunk) {
+            const size_t first = groups.size() * chunk / chunk_count;
+            const size_t last = groups.size() * (chunk + 1) / chunk_count;
+            vector<int> removed_ids;
+            for (size_t g = first; g < last; ++g) {
+                removed_ids.clear();
+                for (size_t i = groups[g].begin; i < groups[g].end; ++i) {
+                    removed_ids.push_back(postings[i].second);
+                }
+                groups[g].documents->EraseSorted(removed_ids);
+            }
         });
-    document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
+
+    for (const auto& group : groups) {
+        if (group.documents->empty()) {
+            word_to_document_freqs_.erase(dictionary_.GetTerm(postings[group.begin].first));
+        }
+    }
+    for (int document_id : document_ids) {
+        ForgetDocument(document_id);
+    }
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
@@ -91,19 +317,243 @@ vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
     return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static map<string_view, double> empty;
-    if (document_to_word_freqs_.count(document_id) == 0) {
-        return empty;
-    } else {
-        return document_to_word_freqs_.at(document_id);
+ResultPage SearchServer::FindTopDocumentsPage(
+    string_view raw_query,
+    const PageCursor& cursor,
+    size_t page_size,
+    DocumentStatus status) const {
+    return FindTopDocumentsPage(
+        raw_query, cursor, page_size,
+        [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        });
+}
+
+ResultPage SearchServer::FindTopDocumentsPage(
+    string_view raw_query,
+    const PageCursor& cursor,
+    size_t page_size) const {
+    return FindTopDocumentsPage(raw_query, cursor, page_size, DocumentStatus::ACTUAL);
+}
+
+ResultPage SearchServer::FindTopDocumentsPage(
+    string_view raw_query,
+    size_t page_index,
+    size_t page_size,
+    DocumentStatus status) const {
+    return FindTopDocumentsPage(
+        raw_query, page_index, page_size,
+        [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        });
+}
+
+ResultPage SearchServer::FindTopDocumentsPage(
+    string_view raw_query,
+    size_t page_index,
+    size_t page_size) const {
+    return FindTopDocumentsPage(raw_query, page_index, page_size, DocumentStatus::ACTUAL);
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(
+    const vector<string>& raw_queries,
+    DocumentStatus status) const {
+    return FindTopDocumentsBatch<TfIdfRanking>(raw_queries, status);
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries) const {
+    return FindTopDocumentsBatch(raw_queries, DocumentStatus::ACTUAL);
+}
+
+future<SearchResult> SearchServer::FindTopDocumentsAsync(
+    string_view raw_query,
+    QueryBudget budget,
+    DocumentStatus status,
+    TaskScheduler& scheduler) const {
+    return FindTopDocumentsAsync(
+        raw_query, move(budget),
+        [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        },
+        scheduler);
+}
+
+void SearchServer::SetQueryAnalytics(QueryAnalytics* analytics) {
+    analytics_ = analytics;
+}
+
+void SearchServer::EnableNearDuplicateDetection(NearDuplicateOptions options,
+                                                NearDuplicateCallback on_near_duplicates) {
+    near_duplicate_index_.emplace(options);
+    near_duplicate_callback_ = move(on_near_duplicates);
+    vector<string_view> words;
+    for (const auto& [document_id, document_terms] : document_to_terms_) {
+        words.clear();
+        for (const auto [term_id, freq] : document_terms) {
+            words.push_back(dictionary_.GetTerm(term_id));
+        }
+        near_duplicate_index_->AddDocument(document_id, words);
+    }
+}
+
+vector<int> SearchServer::FindNearDuplicates(int document_id) const {
+    lock_guard index_guard(writer_sync_.index.readers);
+    if (!near_duplicate_index_) {
+        return {};
+    }
+    return near_duplicate_index_->FindNearDuplicates(document_id);
+}
+
+void SearchServer::EnableFuzzySearch(FuzzySearchOptions options) {
+    if (options.max_distance < 1 || options.max_distance > 2) {
+        throw invalid_argument("Fuzzy search edit distance must be 1 or 2"s);
+    }
+    if (options.penalty <= 0.0 || options.penalty > 1.0) {
+        throw invalid_argument("Fuzzy search penalty must be within (0, 1]"s);
+    }
+    if (options.max_expansions == 0) {
+        throw invalid_argument("Fuzzy search needs at least one expansion"s);
+    }
+    fuzzy_options_ = options;
+}
+
+void SearchServer::SetQueryMode(QueryMode mode) {
+    query_mode_ = mode;
+}
+
+int SearchServer::AddStandingQuery(string_view raw_query, StandingQueryCallback callback, DocumentStatus status) {
+    const auto query = ParseQueryNoDuplicates(raw_query);
+    if (!query.plus_patterns.empty() || !query.minus_patterns.empty()) {
+        throw invalid_argument("Wildcards are not allowed in standing queries"s);
+    }
+    return standing_queries_.Add(query.plus_words, query.minus_words, query.required_words, query.phrases, status,
+                                 move(callback));
+}
+
+void SearchServer::RemoveStandingQuery(int query_id) {
+    standing_queries_.Remove(query_id);
+}
+
+void SearchServer::EnablePositionalIndex() {
+    positional_index_.emplace();
+    vector<int> term_ids;
+    for (const auto& [document_id, document_data] : documents_) {
+        term_ids.clear();
+        for (auto word : SplitIntoWordsNoStop(document_data.text)) {
+            term_ids.push_back(dictionary_.Find(word));
+        }
+        positional_index_->AddDocument(document_id, term_ids);
     }
 }
 
+IndexMemoryUsage SearchServer::GetIndexMemoryUsage() const {
+    lock_guard index_guard(writer_sync_.index.readers);
+    IndexMemoryUsage usage;
+    usage.dictionary = dictionary_.GetMemoryUsage();
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        usage.postings += MAP_NODE_OVERHEAD + sizeof(word) + sizeof(postings) + postings.GetMemoryUsage();
+    }
+    for (const auto& [document_id, document_terms] : document_to_terms_) {
+        usage.forward_index += MAP_NODE_OVERHEAD + sizeof(document_id) + sizeof(document_terms)
+            + document_terms.capacity() * sizeof(TermFrequency);
+    }
+    if (positional_index_) {
+        usage.positions = positional_index_->GetMemoryUsage();
+    }
+    return usage;
+}
+
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    lock_guard index_guard(writer_sync_.index.readers);
+    return ReadWordFrequencies(document_id);
+}
+
 int SearchServer::GetDocumentCount() const {
+    lock_guard index_guard(writer_sync_.index.readers);
+    return CountDocuments();
+}
+
+WordFrequencies SearchServer::ReadWordFrequencies(int document_id) const {
+    const auto it = document_to_terms_.find(document_id);
+    if (it == document_to_terms_.end()) {
+        return {};
+    }
+    return {it->second, dictionary_.GetTerms()};
+}
+
+int SearchServer::CountDocuments() const {
     return documents_.size();
 }
 
+size_t SearchServer::EstimateQueryCost(string_view raw_query) const {
+    lock_guard index_guard(writer_sync_.index.readers);
+    const auto query = ExpandQueryWords(ParseQueryBasic(raw_query));
+    size_t cost = 0;
+    auto add_postings = [this, &cost](const vector<string_view>& words) {
+        for (auto word : words) {
+            ++cost;
+            const auto it = word_to_document_freqs_.find(word);
+            if (it != word_to_document_freqs_.end()) {
+                cost += it->second.size();
+            }
+        }
+    };
+    add_postings(query.plus_words);
+    add_postings(query.minus_words);
+    return cost;
+}
+
+QueryPlan SearchServer::PlanQuery(string_view raw_query) const {
+    lock_guard index_guard(writer_sync_.index.readers);
+    return PlanQuery(ParseQueryNoDuplicates(raw_query));
+}
+
+// Phrases and required words bound the candidates by their rarest word, which
+// is the cheapest filter there is; otherwise a query goes parallel once its postings outweigh
+// the hand-off to the task scheduler. Only PRUNED applies minus-words before
+// scoring: without a candidate bound there is nothing for them to narrow, so
+// SEQUENTIAL and PARALLEL score every plus-word posting and exclude afterwards,
+// and estimated_cost does not shrink for minus-words.
+QueryPlan SearchServer::PlanQuery(const Query& query) const {
+    QueryPlan plan;
+    auto add_words = [this](const vector<string_view>& words, vector<pair<string, size_t>>& planned) {
+        for (auto word : words) {
+            const auto it = word_to_document_freqs_.find(word);
+            planned.push_back({string{word}, it == word_to_document_freqs_.end() ? 0 : it->second.size()});
+        }
+        stable_sort(planned.begin(), planned.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second < rhs.second;
+        });
+    };
+    add_words(query.plus_words, plan.plus_words);
+    add_words(query.minus_words, plan.minus_words);
+
+    size_t scored_word_count = 0;
+    for (const auto& [word, posting_count] : plan.plus_words) {
+        plan.estimated_cost += posting_count;
+        scored_word_count += posting_count > 0 ? 1 : 0;
+    }
+    if (!query.phrases.empty() || !query.required_words.empty()) {
+        plan.execution = QueryExecution::PRUNED;
+        size_t candidate_bound = numeric_limits<size_t>::max();
+        auto bound_by = [this, &candidate_bound](const vector<string_view>& words) {
+            for (auto word : words) {
+                const auto it = word_to_document_freqs_.find(word);
+                candidate_bound = min(candidate_bound, it == word_to_document_freqs_.end() ? 0 : it->second.size());
+            }
+        };
+        bound_by(query.required_words);
+        for (const auto& phrase : query.phrases) {
+            bound_by(phrase);
+        }
+        plan.estimated_cost = min(plan.estimated_cost, candidate_bound * scored_word_count);
+    } else if (scored_word_count > 1 && TaskScheduler::Instance().GetThreadCount() > 1
+               && plan.estimated_cost >= PARALLEL_QUERY_MIN_POSTINGS) {
+        plan.execution = QueryExecution::PARALLEL;
+    }
+    return plan;
+}
+
 set<int>::const_iterator SearchServer::begin() const {
     return document_ids_.begin();
 }
@@ -114,67 +564,253 @@ set<int>::const_iterator SearchServer::end() const {
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query,
                                                                        int document_id) const {                          
-    auto query = ParseQueryNoDuplicates(raw_query);
-    
-    if (any_of(query.minus_words.begin(),
-               query.minus_words.end(),
-               [this, document_id](const auto& word) {
-                   return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id);
-               })) {
-        return {{}, documents_.at(document_id).status};
+    lock_guard index_guard(writer_sync_.index.readers);
+    if (documents_.count(document_id) == 0) {
+        throw invalid_argument("Invalid document_id"s);
     }
+    METRICS_TIMER(timer);
+    auto query = ExpandQueryWords(ParseQueryNoDuplicates(raw_query));
+    query.EraseDuplicates();
+    METRICS_CHECKPOINT(timer, Metric::QUERY_PARSE);
     
     vector<string_view> matched_words;
-    for (auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
-        }
-    }
-    
-return {matched_words, documents_.at(document_id).status};
+    MatchWords(GetTermIds(query.plus_words), GetTermIds(query.minus_words), GetRequiredTermIds(query.required_words),
+               query.phrases, document_id, matched_words);
+    METRICS_CHECKPOINT(timer, Metric::DOCUMENT_MATCH);
+    return {matched_words, documents_.at(document_id).GetMetadata().status};
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
-    execution::sequenced_policy policy, 
+    execution::sequenced_policy,
     string_view raw_query,
     int document_id) const {
     return MatchDocument(raw_query, document_id);
 }
 
+// One document is matched by binary searches in its sorted term array, cheaper than
+// handing its words to the scheduler, so both policies share the one path.
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
-    execution::parallel_policy policy, 
+    execution::parallel_policy,
     string_view raw_query,
     int document_id) const {
-    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
-        throw invalid_argument("Invalid document_id"s);
-    }
-    auto query = ParseQueryBasic(raw_query);
-    
-    if (any_of(query.minus_words.begin(),
-               query.minus_words.end(),
-               [this, document_id](auto word) {
-                   return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id);
-               })) {
-        return {{}, documents_.at(document_id).status};
+    return MatchDocument(raw_query, document_id);
+}
+
+MatchedDocuments SearchServer::MatchDocuments(string_view raw_query, const vector<int>& document_ids) const {
+    lock_guard index_guard(writer_sync_.index.readers);
+    for (int document_id : document_ids) {
+        if (documents_.count(document_id) == 0) {
+            throw invalid_argument("Invalid document_id"s);
+        }
     }
-    
-    vector<string_view> matched_words(query.plus_words.size());
-    auto last = copy_if(
-        policy,
-        query.plus_words.begin(),
-        query.plus_words.end(),
-        matched_words.begin(),
-        [&matched_words, this, document_id](auto word) {
-            return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id);
+    METRICS_TIMER(timer);
+    auto query = ExpandQueryWords(ParseQueryNoDuplicates(raw_query));
+    query.EraseDuplicates();
+    const auto plus_term_ids = GetTermIds(query.plus_words);
+    const auto minus_term_ids = GetTermIds(query.minus_words);
+    const auto required_term_ids = GetRequiredTermIds(query.required_words);
+    METRICS_CHECKPOINT(timer, Metric::QUERY_PARSE);
+
+    // Every chunk of documents is matched into its own buffer; the buffers
+    // are then concatenated in document order.
+    auto& scheduler = TaskScheduler::Instance();
+    const size_t chunk_count = min(document_ids.size(), scheduler.GetThreadCount() * 4);
+    vector<vector<string_view>> chunk_words(chunk_count);
+    MatchedDocuments result;
+    result.offsets.assign(document_ids.size() + 1, 0);
+    result.statuses.resize(document_ids.size());
+    scheduler.ParallelFor(
+        chunk_count,
+        [&](size_t chunk) {
+            const size_t first = document_ids.size() * chunk / chunk_count;
+            const size_t last = document_ids.size() * (chunk + 1) / chunk_count;
+            auto& words = chunk_words[chunk];
+            for (size_t i = first; i < last; ++i) {
+                MatchWords(plus_term_ids, minus_term_ids, required_term_ids, query.phrases, document_ids[i], words);
+                // chunk-local end offset, shifted to a global one below
+                result.offsets[i + 1] = words.size();
+                result.statuses[i] = documents_.at(document_ids[i]).GetMetadata().status;
+            }
         });
-    
-    sort(matched_words.begin(), last);
-    last = unique(matched_words.begin(), last);
-    matched_words.erase(last, matched_words.end());
-    return {matched_words, documents_.at(document_id).status};
+
+    size_t chunk_offset = 0;
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        const size_t first = document_ids.size() * chunk / chunk_count;
+        const size_t last = document_ids.size() * (chunk + 1) / chunk_count;
+        for (size_t i = first; i < last; ++i) {
+            result.offsets[i + 1] += chunk_offset;
+        }
+        chunk_offset += chunk_words[chunk].size();
+        result.words.insert(result.words.end(), chunk_words[chunk].begin(), chunk_words[chunk].end());
+    }
+    METRICS_CHECKPOINT(timer, Metric::DOCUMENT_MATCH);
+    return result;
+}
+
+// Binary searches the query terms in the document's sorted term array.
+// Appends nothing if the document has a minus-word or lacks a required word
+// or a phrase. The appended views point into the index, not into the query
+// text.
+void SearchServer::MatchWords(const vector<int>& plus_term_ids, const vector<int>& minus_term_ids,
+                              const vector<int>& required_term_ids, const vector<vector<string_view>>& phrases,
+                              int document_id, vector<string_view>& matched_words) const {
+    const auto word_freqs = ReadWordFrequencies(document_id);
+    for (int term_id : minus_term_ids) {
+        if (word_freqs.ContainsTerm(term_id)) {
+            return;
+        }
+    }
+    for (int term_id : required_term_ids) {
+        if (!word_freqs.ContainsTerm(term_id)) {
+            return;
+        }
+    }
+    if (!ContainsPhrases(document_id, phrases)) {
+        return;
+    }
+    for (int term_id : plus_term_ids) {
+        if (word_freqs.ContainsTerm(term_id)) {
+            matched_words.push_back(dictionary_.GetTerm(term_id));
+        }
+    }
+}
+
+// An unknown required word keeps NO_TERM, which no document contains.
+vector<int> SearchServer::GetRequiredTermIds(const vector<string_view>& words) const {
+    vector<int> term_ids;
+    term_ids.reserve(words.size());
+    for (auto word : words) {
+        term_ids.push_back(dictionary_.Find(word));
+    }
+    return term_ids;
+}
+
+// Shortest posting list first, ties and unknown words kept in the given
+// (sorted) order. Every search path adds plus-words in this order, so their
+// sums are bit-identical, and PlanQuery reports it.
+vector<string_view> SearchServer::OrderRarestFirst(const vector<string_view>& words) const {
+    vector<pair<size_t, string_view>> ordered;
+    ordered.reserve(words.size());
+    for (auto word : words) {
+        const auto it = word_to_document_freqs_.find(word);
+        ordered.push_back({it == word_to_document_freqs_.end() ? 0 : it->second.size(), word});
+    }
+    stable_sort(ordered.begin(), ordered.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+    vector<string_view> result;
+    result.reserve(ordered.size());
+    for (const auto& [posting_count, word] : ordered) {
+        result.push_back(word);
+    }
+    return result;
+}
+
+// Ids of the known words, in the order of the words; unknown words are skipped.
+vector<int> SearchServer::GetTermIds(const vector<string_view>& words) const {
+    vector<int> term_ids;
+    term_ids.reserve(words.size());
+    for (auto word : words) {
+        const int term_id = dictionary_.Find(word);
+        if (term_id != TermDictionary::NO_TERM) {
+            term_ids.push_back(term_id);
+        }
+    }
+    return term_ids;
+}
+
+bool SearchServer::IsIndexed(string_view word) const {
+    const auto it = word_to_document_freqs_.find(word);
+    return it != word_to_document_freqs_.end() && !it->second.empty();
+}
+
+// Words matching the pattern, the ones in most documents first.
+vector<SearchServer::WordExpansion> SearchServer::ExpandPattern(string_view pattern, size_t max_expansions) const {
+    vector<WordExpansion> expansions;
+    for (const int term_id : dictionary_.FindByPattern(pattern)) {
+        const auto it = word_to_document_freqs_.find(dictionary_.GetTerm(term_id));
+        if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+            expansions.push_back({it, 1.0});
+        }
+    }
+    stable_sort(expansions.begin(), expansions.end(),
+                [](const WordExpansion& lhs, const WordExpansion& rhs) {
+                    return lhs.word->second.size() > rhs.word->second.size();
+                });
+    if (expansions.size() > max_expansions) {
+        expansions.resize(max_expansions);
+    }
+    return expansions;
+}
+
+// Indexed words close to an unknown one, the closest and then the most
+// frequent first. Empty unless fuzzy search is enabled.
+vector<SearchServer::WordExpansion> SearchServer::ExpandFuzzy(string_view word) const {
+    if (!fuzzy_options_) {
+        return {};
+    }
+    const auto letter_count = count_if(word.begin(), word.end(),
+                                       [](char c) {
+                                           return (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+                                       });
+    const int max_distance = min(fuzzy_options_->max_distance, letter_count < 3 ? 0 : letter_count < 6 ? 1 : 2);
+    if (max_distance == 0) {
+        return {};
+    }
+    vector<pair<int, WordExpansion>> found;
+    for (const auto& [term_id, distance] : dictionary_.FindFuzzy(word, max_distance)) {
+        const auto it = word_to_document_freqs_.find(dictionary_.GetTerm(term_id));
+        if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+            found.push_back({distance, {it, pow(fuzzy_options_->penalty, distance)}});
+        }
+    }
+    stable_sort(found.begin(), found.end(),
+                [](const auto& lhs, const auto& rhs) {
+                    if (lhs.first != rhs.first) {
+                        return lhs.first < rhs.first;
+                    }
+                    return lhs.second.word->second.size() > rhs.second.word->second.size();
+                });
+    vector<WordExpansion> expansions;
+    for (size_t i = 0; i < found.size() && i < fuzzy_options_->max_expansions; ++i) {
+        expansions.push_back(found[i].second);
+    }
+    return expansions;
+}
+
+// Replaces patterns and misspelled words by the indexed words they stand for,
+// for matching single documents.
+SearchServer::Query SearchServer::ExpandQueryWords(Query query) const {
+    const size_t plus_word_count = query.plus_words.size();
+    for (size_t i = 0; i < plus_word_count; ++i) {
+        if (!IsIndexed(query.plus_words[i])) {
+            for (const auto& expansion : ExpandFuzzy(query.plus_words[i])) {
+                query.plus_words.push_back(expansion.word->first);
+            }
+        }
+    }
+    for (auto pattern : query.plus_patterns) {
+        for (const auto& expansion : ExpandPattern(pattern, MAX_PATTERN_EXPANSIONS)) {
+            query.plus_words.push_back(expansion.word->first);
+        }
+    }
+    for (auto pattern : query.minus_patterns) {
+        for (const auto& expansion : ExpandPattern(pattern, numeric_limits<size_t>::max())) {
+            query.minus_words.push_back(expansion.word->first);
+        }
+    }
+    query.plus_patterns.clear();
+    query.minus_patterns.clear();
+    return query;
+}
+
+// Minus-patterns exclude every matching word, regardless of the expansion limit.
+void SearchServer::ExcludePatternDocuments(const Query& query, ScoreAccumulator& document_to_relevance) const {
+    for (auto pattern : query.minus_patterns) {
+        for (const auto& expansion : ExpandPattern(pattern, numeric_limits<size_t>::max())) {
+            ExcludeDocuments(expansion.word->second, document_to_relevance);
+        }
+    }
 }
 
 bool SearchServer::IsStopWord(string_view word) const {
@@ -187,7 +823,7 @@ bool SearchServer::IsValidWord(string_view word) {
     });
 }
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(const string& text) const {
+vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
     vector<string_view> words;
     for (auto word : SplitIntoWordsView(text)) {
         if (!IsValidWord(word)) {
@@ -210,15 +846,19 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view word) const {
     }
    
     bool is_minus = false;
+    bool is_required = false;
     if (word[0] == '-') {
         is_minus = true;
         word = word.substr(1);
+    } else if (word[0] == '+') {
+        is_required = true;
+        word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+    if (word.empty() || word[0] == '-' || word[0] == '+' || !IsValidWord(word)) {
         throw invalid_argument("Query word is invalid");
     }
 
-    return {word, is_minus, IsStopWord(word)};
+    return {word, is_minus, is_required, IsStopWord(word)};
 }
 
 SearchServer::Query SearchServer::ParseQueryNoDuplicates(string_view query_text) const{
@@ -227,21 +867,283 @@ SearchServer::Query SearchServer::ParseQueryNoDuplicates(string_view query_text)
     return query;
 }
 
+// A phrase is a run of words in double quotes: "white cat". Its words are
+// plus-words that must also stand next to each other, stop words aside.
 SearchServer::Query SearchServer::ParseQueryBasic(string_view query_text) const{
     Query query;
+    bool in_phrase = false;
     for (auto word : SplitIntoWordsView(query_text)) {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
-            } else {
-                query.plus_words.push_back(query_word.data);
+        const bool opens_phrase = !in_phrase && !word.empty() && word[0] == '"';
+        if (opens_phrase) {
+            in_phrase = true;
+            query.phrases.emplace_back();
+            word.remove_prefix(1);
+        }
+        const bool closes_phrase = in_phrase && !word.empty() && word.back() == '"';
+        if (closes_phrase) {
+            word.remove_suffix(1);
+        }
+        // a lone quote leaves nothing to parse
+        if (!word.empty() || !(opens_phrase || closes_phrase)) {
+            const auto query_word = ParseQueryWord(word);
+            if (in_phrase && query_word.is_minus) {
+                throw invalid_argument("Minus-words are not allowed in a phrase"s);
+            }
+            if (IsPattern(query_word.data)) {
+                if (in_phrase) {
+                    throw invalid_argument("Wildcards are not allowed in a phrase"s);
+                }
+                if (query_word.is_required) {
+                    throw invalid_argument("Wildcards cannot be required"s);
+                }
+                (query_word.is_minus ? query.minus_patterns : query.plus_patterns).push_back(query_word.data);
+            } else if (!query_word.is_stop) {
+                if (query_word.is_minus) {
+                    query.minus_words.push_back(query_word.data);
+                } else {
+                    query.plus_words.push_back(query_word.data);
+                    if (query_word.is_required || query_mode_ == QueryMode::ALL_WORDS) {
+                        query.required_words.push_back(query_word.data);
+                    }
+                    if (in_phrase) {
+                        query.phrases.back().push_back(query_word.data);
+                    }
+                }
             }
         }
+        if (closes_phrase) {
+            in_phrase = false;
+            // a single word is an ordinary plus-word
+            if (query.phrases.back().size() < 2) {
+                query.phrases.pop_back();
+            }
+        }
+    }
+    if (in_phrase) {
+        throw invalid_argument("Phrase has no closing quote"s);
     }
     return query;
 }
 
-    double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+void SearchServer::SelectTopDocuments(vector<Document>& documents) {
+    sort(documents.begin(), documents.end(),
+         [](const Document& lhs, const Document& rhs) {
+             if (abs(lhs.relevance - rhs.relevance) < 1e-6) {
+                 return lhs.rating > rhs.rating;
+             } else {
+                 return lhs.relevance > rhs.relevance;
+             }
+         });
+    
+    if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+}
+
+QueryAnalytics::Clock::time_point SearchServer::StartQueryTiming() const {
+    return analytics_ != nullptr ? QueryAnalytics::Clock::now() : QueryAnalytics::Clock::time_point{};
+}
+
+void SearchServer::RecordQuery(string_view raw_query, size_t result_count,
+                               QueryAnalytics::Clock::time_point start_time) const {
+    if (analytics_ != nullptr) {
+        analytics_->Record(raw_query, result_count, QueryAnalytics::Clock::now() - start_time);
+    }
+}
+
+bool SearchServer::IsRankedBefore(const Document& lhs, const Document& rhs) {
+    return tie(rhs.relevance, rhs.rating, lhs.id) < tie(lhs.relevance, lhs.rating, rhs.id);
+}
+
+// Only the first skip_count + page_size documents are ordered, the rest is
+// just partitioned off.
+ResultPage SearchServer::SelectPage(vector<Document>& documents, size_t skip_count, size_t page_size) {
+    ResultPage page;
+    if (skip_count >= documents.size() || page_size == 0) {
+        page.next_page.is_start_ = false;
+        page.next_page.is_end_ = true;
+        return page;
+    }
+    const size_t page_end = min(documents.size(), skip_count + page_size);
+    if (skip_count > 0) {
+        nth_element(documents.begin(), documents.begin() + skip_count, documents.end(), IsRankedBefore);
+    }
+    const auto first = documents.begin() + skip_count;
+    partial_sort(first, documents.begin() + page_end, documents.end(), IsRankedBefore);
+    page.documents.assign(first, documents.begin() + page_end);
+
+    const Document& last = page.documents.back();
+    page.next_page.is_start_ = false;
+    page.next_page.is_end_ = page_end == documents.size();
+    page.next_page.relevance_ = last.relevance;
+    page.next_page.rating_ = last.rating;
+    page.next_page.id_ = last.id;
+    return page;
+}
+
+// Candidates are the intersection of the phrase words' posting lists, starting
+// from the rarest one, so positions are only read for documents that contain
+// every word and the cost follows the rarest word.
+vector<int> SearchServer::FindPhraseDocuments(const vector<string_view>& phrase,
+                                              const function<bool()>& should_stop) const {
+    vector<int> phrase_term_ids;
+    vector<const PostingList*> word_postings;
+    for (auto word : phrase) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            return {};
+        }
+        phrase_term_ids.push_back(dictionary_.Find(word));
+        word_postings.push_back(&it->second);
+    }
+    sort(word_postings.begin(), word_postings.end(),
+         [](const PostingList* lhs, const PostingList* rhs) {
+             return lhs->size() < rhs->size();
+         });
+
+    vector<int> candidates(word_postings[0]->GetDocumentIds(),
+                           word_postings[0]->GetDocumentIds() + word_postings[0]->size());
+    for (size_t i = 1; i < word_postings.size() && !candidates.empty(); ++i) {
+        if (should_stop()) {
+            return {};
+        }
+        const int* const first = word_postings[i]->GetDocumentIds();
+        const int* const last = first + word_postings[i]->size();
+        const int* position = first;
+        candidates.erase(
+            remove_if(candidates.begin(), candidates.end(),
+                      [&position, last](int document_id) {
+                          position = lower_bound(position, last, document_id);
+                          return position == last || *position != document_id;
+                      }),
+            candidates.end());
+    }
+
+    // verifying positions is the costly part, so it is checked block by block
+    bool stopped = false;
+    size_t checked_count = 0;
+    candidates.erase(
+        remove_if(candidates.begin(), candidates.end(),
+                  [&](int document_id) {
+                      if (!stopped && ++checked_count % POSTING_BLOCK_SIZE == 0) {
+                          stopped = should_stop();
+                      }
+                      return stopped || !ContainsPhrase(document_id, phrase, phrase_term_ids);
+                  }),
+        candidates.end());
+    return stopped ? vector<int>{} : candidates;
+}
+
+// Reads positions if they are indexed, otherwise re-tokenizes the text.
+bool SearchServer::ContainsPhrase(int document_id, const vector<string_view>& phrase,
+                                  const vector<int>& phrase_term_ids) const {
+    if (positional_index_) {
+        return positional_index_->ContainsPhrase(document_id, phrase_term_ids);
+    }
+    const auto words = SplitIntoWordsNoStop(documents_.at(document_id).text);
+    return search(words.begin(), words.end(), phrase.begin(), phrase.end()) != words.end();
+}
+
+bool SearchServer::ContainsPhrases(int document_id, const vector<vector<string_view>>& phrases) const {
+    const auto word_freqs = ReadWordFrequencies(document_id);
+    for (const auto& phrase : phrases) {
+        const auto phrase_term_ids = GetRequiredTermIds(phrase);
+        const bool has_words = all_of(phrase_term_ids.begin(), phrase_term_ids.end(), [&word_freqs](int term_id) {
+            return word_freqs.ContainsTerm(term_id);
+        });
+        if (!has_words || !ContainsPhrase(document_id, phrase, phrase_term_ids)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Documents containing every required word and phrase and no minus-word.
+// Required postings are intersected rarest first, so the candidates only
+// shrink; phrases are verified and minus-words checked for what is left.
+vector<int> SearchServer::FindCandidateDocuments(const Query& query, const function<bool()>& should_stop) const {
+    vector<const PostingList*> required_postings;
+    for (auto word : query.required_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            return {};
+        }
+        required_postings.push_back(&it->second);
+    }
+    sort(required_postings.begin(), required_postings.end(),
+         [](const PostingList* lhs, const PostingList* rhs) {
+             return lhs->size() < rhs->size();
+         });
+
+    vector<int> candidates;
+    size_t phrase_index = 0;
+    if (!required_postings.empty()) {
+        candidates.assign(required_postings[0]->GetDocumentIds(),
+                          required_postings[0]->GetDocumentIds() + required_postings[0]->size());
+        for (size_t i = 1; i < required_postings.size() && !candidates.empty(); ++i) {
+            if (should_stop()) {
+                return {};
+            }
+            IntersectDocuments(*required_postings[i], candidates);
+        }
+    } else {
+        candidates = FindPhraseDocuments(query.phrases.front(), should_stop);
+        phrase_index = 1;
+    }
+    for (; phrase_index < query.phrases.size() && !candidates.empty(); ++phrase_index) {
+        const auto phrase_documents = FindPhraseDocuments(query.phrases[phrase_index], should_stop);
+        candidates.erase(remove_if(candidates.begin(), candidates.end(),
+                                   [&phrase_documents](int document_id) {
+                                       return !binary_search(phrase_documents.begin(), phrase_documents.end(),
+                                                             document_id);
+                                   }),
+                         candidates.end());
+    }
+
+    auto exclude = [&candidates](const PostingList& postings) {
+        const int* const first = postings.GetDocumentIds();
+        const int* const last = first + postings.size();
+        candidates.erase(remove_if(candidates.begin(), candidates.end(),
+                                   [first, last](int document_id) {
+                                       return binary_search(first, last, document_id);
+                                   }),
+                         candidates.end());
+    };
+    for (auto word : query.minus_words) {
+        if (should_stop()) {
+            return {};
+        }
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end()) {
+            exclude(it->second);
+        }
+    }
+    for (auto pattern : query.minus_patterns) {
+        if (should_stop()) {
+            return {};
+        }
+        for (const auto& expansion : ExpandPattern(pattern, numeric_limits<size_t>::max())) {
+            exclude(expansion.word->second);
+        }
+    }
+    return candidates;
+}
+
+void SearchServer::KeepPhraseDocuments(const Query& query, ScoreAccumulator& document_to_relevance,
+                                       const function<bool()>& should_stop) const {
+    for (const auto& phrase : query.phrases) {
+        KeepDocuments(FindPhraseDocuments(phrase, should_stop), document_to_relevance);
+    }
+}
+
+bool SearchServer::NeverStop() {
+    return false;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
+    return TfIdfRanking::ComputeInverseDocumentFreq(CountDocuments(), word_to_document_freqs_.at(word).size());
+}
+
+double SearchServer::GetAverageDocumentLength() const {
+    return documents_.empty() ? 0.0 : static_cast<double>(total_word_count_) / documents_.size();
 }
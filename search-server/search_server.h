@@ -1,6 +1,8 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
 #include <iostream>
 #include <map>
@@ -11,15 +13,63 @@
 #include <vector>
 #include <string>
 #include <execution>
+#include <functional>
 #include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <limits>
 
 #include "document.h"
 #include "string_processing.h"
 #include "log_duration.h"
-#include "concurrent_map.h"
+#include "task_scheduler.h"
+#include "query_budget.h"
+#include "near_duplicates.h"
+#include "result_page.h"
+#include "matched_documents.h"
+#include "word_frequencies.h"
+#include "posting_list.h"
+#include "scoring_kernel.h"
+#include "ranking.h"
+#include "positional_index.h"
+#include "memory_usage.h"
+#include "term_dictionary.h"
+#include "query_analytics.h"
+#include "query_plan.h"
+#include "metrics.h"
+#include "standing_queries.h"
+#include "phase_lock.h"
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
+// Async queries check their budget once per this many scanned postings.
+const int POSTING_BLOCK_SIZE = 1024;
+// A prefix* or wild?card query word stands for at most this many words,
+// the ones found in most documents.
+const size_t MAX_PATTERN_EXPANSIONS = 64;
+const size_t POSTING_LOCK_STRIPES = 64;
+
+// How plus-words combine: a document matches if it contains any of them, or
+// all of them. In either mode "+word" makes a single word required.
+enum class QueryMode {
+    ANY_WORD,
+    ALL_WORDS,
+};
+
+// below this many plus-word postings a parallel query costs more in task
+// hand-offs than it saves
+const size_t PARALLEL_QUERY_MIN_POSTINGS = 1 << 15;
+
+struct FuzzySearchOptions {
+    // 1 or 2; words shorter than 3 letters are never corrected, words shorter
+    // than 6 letters by one edit at most
+    int max_distance = 1;
+    // a corrected word scores penalty^distance of an exact one
+    double penalty = 0.5;
+    size_t max_expansions = 16;
+};
 
 class SearchServer {
 public:
@@ -28,26 +78,122 @@ public:
     explicit SearchServer(std::string_view stop_words);
     explicit SearchServer(const std::string& stop_words_text);
 
+    // AddDocument and AddTokenizedDocument may be called from many threads at
+    // once, also alongside queries and UpdateDocumentStatus/UpdateDocumentRating.
+    // A query sees every document either fully indexed or not at all: it waits
+    // for the running writers, and writers arriving meanwhile wait for it.
+    // Removals, the Enable* methods and iteration over the ids must not
+    // overlap writers.
     void AddDocument(int document_id, std::string_view document, DocumentStatus status,
         const std::vector<int>& ratings);
+    // Adds the document under the next free id and returns it; the ids are
+    // allocated without a lock and are above every id added before.
+    int AddDocument(std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // AddDocument in two steps for ingestion pipelines. TokenizeDocument only
+    // reads the stop words, so it may run on other threads while documents
+    // are being indexed. AddTokenizedDocument does not copy the text: it and
+    // the words must point into `storage`, which the server keeps alive.
+    std::vector<std::string_view> TokenizeDocument(std::string_view document) const;
+    void AddTokenizedDocument(int document_id, std::string_view document, const std::vector<std::string_view>& words,
+        DocumentStatus status, const std::vector<int>& ratings, std::shared_ptr<const void> storage);
     void RemoveDocument(int document_id);
+    // Change the metadata of an indexed document in place, without touching
+    // its postings. Safe to call while queries or AddDocument run on other
+    // threads.
+    void UpdateDocumentStatus(int document_id, DocumentStatus status);
+    void UpdateDocumentRating(int document_id, const std::vector<int>& ratings);
     void RemoveDocument(std::execution::sequenced_policy policy, int document_id);
     void RemoveDocument(std::execution::parallel_policy policy, int document_id);
-    template <typename DocumentPredicate, typename ExecutionPolicy>
+    // Removes all listed documents at once, unknown ids are ignored. Postings
+    // are grouped by word and every posting list is rewritten by one thread.
+    void RemoveDocuments(std::vector<int> document_ids);
+    // The ranking policy (see ranking.h) is the optional first template
+    // argument, e.g. FindTopDocuments<Bm25Ranking>(raw_query); TF-IDF by default.
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query,
         DocumentPredicate document_predicate) const;
-    template <typename ExecutionPolicy>
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query,
         DocumentStatus status) const;
-    template <typename ExecutionPolicy>
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query) const;
-    template <typename DocumentPredicate>
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query,
         DocumentPredicate document_predicate) const;
+    template <typename Ranking>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    template <typename Ranking>
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+    // Paged search. Pages follow relevance, then rating, then id, with exact
+    // comparisons so that every document has one position a cursor can name.
+    template <typename DocumentPredicate>
+    ResultPage FindTopDocumentsPage(std::string_view raw_query, const PageCursor& cursor, size_t page_size,
+        DocumentPredicate document_predicate) const;
+    ResultPage FindTopDocumentsPage(std::string_view raw_query, const PageCursor& cursor, size_t page_size,
+        DocumentStatus status) const;
+    ResultPage FindTopDocumentsPage(std::string_view raw_query, const PageCursor& cursor, size_t page_size) const;
+    template <typename DocumentPredicate>
+    ResultPage FindTopDocumentsPage(std::string_view raw_query, size_t page_index, size_t page_size,
+        DocumentPredicate document_predicate) const;
+    ResultPage FindTopDocumentsPage(std::string_view raw_query, size_t page_index, size_t page_size,
+        DocumentStatus status) const;
+    ResultPage FindTopDocumentsPage(std::string_view raw_query, size_t page_index, size_t page_size) const;
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+        DocumentPredicate document_predicate) const;
+    template <typename Ranking>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+        DocumentStatus status) const;
+    template <typename Ranking>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+        DocumentStatus status) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const;
+    // Runs the query on the scheduler and returns at once. The task keeps a
+    // pointer to the server, so the server must outlive the returned future.
+    template <typename DocumentPredicate>
+    std::future<SearchResult> FindTopDocumentsAsync(std::string_view raw_query, QueryBudget budget,
+        DocumentPredicate document_predicate, TaskScheduler& scheduler = TaskScheduler::Instance()) const;
+    std::future<SearchResult> FindTopDocumentsAsync(std::string_view raw_query, QueryBudget budget,
+        DocumentStatus status = DocumentStatus::ACTUAL, TaskScheduler& scheduler = TaskScheduler::Instance()) const;
+    // Every search request is reported to the given analytics, nullptr
+    // turns reporting off. The analytics must outlive the server.
+    void SetQueryAnalytics(QueryAnalytics* analytics);
+    // Starts maintaining MinHash signatures: existing documents are indexed
+    // at once, later ones on AddDocument. When a later document has
+    // near-duplicates, the callback gets them, with no lock held and
+    // possibly on several writer threads at once.
+    void EnableNearDuplicateDetection(NearDuplicateOptions options = {},
+        NearDuplicateCallback on_near_duplicates = {});
+    // Ids of documents whose word sets are similar to the given one; empty
+    // unless near-duplicate detection is enabled.
+    std::vector<int> FindNearDuplicates(int document_id) const;
+    // Starts recording word positions for "quoted phrase" queries: existing
+    // documents are indexed at once, later ones on AddDocument. Without the
+    // index phrases still work, but candidates are re-tokenized.
+    void EnablePositionalIndex();
+    // Plus-words missing from the index are replaced by indexed words within
+    // a small edit distance, found with a Levenshtein automaton.
+    void EnableFuzzySearch(FuzzySearchOptions options = {});
+    // Required words are intersected, rarest first, before anything is
+    // scored. Patterns and typo corrections are never required, and a
+    // required word missing from the index matches nothing.
+    void SetQueryMode(QueryMode mode);
+    // Registers a query that is matched against every document added from
+    // now on; the callback may run on several writer threads at once. Words
+    // are matched exactly, wildcards are rejected, and the query mode is the
+    // one set at registration. Must not overlap AddDocument.
+    int AddStandingQuery(std::string_view raw_query, StandingQueryCallback callback,
+        DocumentStatus status = DocumentStatus::ACTUAL);
+    void RemoveStandingQuery(int query_id);
+    IndexMemoryUsage GetIndexMemoryUsage() const;
+    WordFrequencies GetWordFrequencies(int document_id) const;
     int GetDocumentCount() const;
+    size_t EstimateQueryCost(std::string_view raw_query) const;
+    // The execution FindTopDocuments(adaptive_execution, raw_query) would use.
+    QueryPlan PlanQuery(std::string_view raw_query) const;
     std::set<int>::const_iterator begin() const;
     std::set<int>::const_iterator end() const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
@@ -56,29 +202,111 @@ public:
         std::execution::parallel_policy policy, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
         std::execution::sequenced_policy policy, std::string_view raw_query, int document_id) const;
+    // Parses the query once and matches it against all given documents in
+    // parallel, e.g. for highlighting a page of results.
+    MatchedDocuments MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
     
 private:
-    struct DocumentData {
+    // Rating and status live in one atomic word: a query running during
+    // UpdateDocumentStatus/UpdateDocumentRating sees the old pair or the new
+    // one, never a mix.
+    struct DocumentMetadata {
         int rating;
         DocumentStatus status;
     };
+
+    struct DocumentData {
+        DocumentData(DocumentMetadata metadata, int word_count, std::string_view text)
+            : metadata(metadata)
+            , word_count(word_count)
+            , text(text) {
+        }
+        DocumentData(const DocumentData& other)
+            : metadata(other.GetMetadata())
+            , word_count(other.word_count)
+            , text(other.text) {
+        }
+        DocumentData& operator=(const DocumentData& other) {
+            metadata.store(other.GetMetadata(), std::memory_order_relaxed);
+            word_count = other.word_count;
+            text = other.text;
+            return *this;
+        }
+
+        DocumentMetadata GetMetadata() const {
+            return metadata.load(std::memory_order_relaxed);
+        }
+
+        std::atomic<DocumentMetadata> metadata;
+        // number of words without stop words
+        int word_count;
+        std::string_view text;
+    };
     
     std::deque<std::string> doc_storage_;
+    // buffers holding the texts of documents added without a copy
+    std::vector<std::shared_ptr<const void>> pinned_storage_;
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<int , std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+    // term dictionary: words get dense ids in order of first appearance
+    TermDictionary dictionary_;
+    // forward index: (term id, tf) pairs of every document sorted by term id
+    std::map<int, std::vector<TermFrequency>> document_to_terms_;
+    using PostingMap = std::map<std::string_view, PostingList>;
+    PostingMap word_to_document_freqs_;
     std::map<int, DocumentData> documents_;
+    // sum of word_count over documents_, for the average document length
+    long long total_word_count_ = 0;
     std::set<int> document_ids_;
+    std::optional<NearDuplicateIndex> near_duplicate_index_;
+    NearDuplicateCallback near_duplicate_callback_;
+    std::optional<PositionalIndex> positional_index_;
+    std::optional<FuzzySearchOptions> fuzzy_options_;
+    QueryMode query_mode_ = QueryMode::ANY_WORD;
+    StandingQueryIndex standing_queries_;
+    QueryAnalytics* analytics_ = nullptr;
+
+    // Synchronization of concurrent writers with each other and with
+    // queries. A copy gets fresh locks and keeps only the next free id;
+    // copying a server that writers are still changing is not supported.
+    struct WriterSync {
+        WriterSync() = default;
+        WriterSync(const WriterSync& other)
+            : next_document_id(other.next_document_id.load()) {
+        }
+        WriterSync& operator=(const WriterSync& other) {
+            next_document_id = other.next_document_id.load();
+            return *this;
+        }
+
+        // document table and text storage
+        std::mutex documents;
+        // term dictionary together with the set of posting lists
+        std::mutex dictionary;
+        // posting list contents, striped by term id
+        std::array<std::mutex, POSTING_LOCK_STRIPES> postings;
+        std::atomic<int> next_document_id{0};
+        // queries on one side, writers on the other
+        mutable PhaseLock index;
+    };
+    WriterSync writer_sync_;
 
     struct QueryWord {
         std::string_view data;
         bool is_minus;
+        bool is_required;
         bool is_stop;
     };
 
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        // words of every phrase, which are plus-words as well
+        std::vector<std::vector<std::string_view>> phrases;
+        // plus-words every matched document must contain
+        std::vector<std::string_view> required_words;
+        // words with '*' or '?' wildcards
+        std::vector<std::string_view> plus_patterns;
+        std::vector<std::string_view> minus_patterns;
         
         void EraseDuplicates() {
             std::sort(plus_words.begin(), plus_words.end());
@@ -88,27 +316,102 @@ private:
             std::sort(minus_words.begin(), minus_words.end());
             auto last_m = std::unique(minus_words.begin(), minus_words.end());
             minus_words.erase(last_m, minus_words.end());
+
+            for (auto* words : {&required_words, &plus_patterns, &minus_patterns}) {
+                std::sort(words->begin(), words->end());
+                words->erase(std::unique(words->begin(), words->end()), words->end());
+            }
         }
     };
     
     bool IsStopWord(std::string_view word) const;
     static bool IsValidWord(std::string_view word);
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string& text) const;
+    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
     static int ComputeAverageRating(const std::vector<int>& ratings);
+    void ClaimDocumentId(int document_id, DocumentMetadata metadata);
+    std::atomic<DocumentMetadata>& FindDocumentMetadata(int document_id);
+    void ReleaseDocumentId(int document_id);
+    void ForgetDocument(int document_id);
+    void IndexDocument(int document_id, std::string_view document, const std::vector<std::string_view>& words,
+        std::unique_lock<PhaseLock::Side> index_guard);
+    // the public getters without the read lock, for callers that hold it
+    int CountDocuments() const;
+    WordFrequencies ReadWordFrequencies(int document_id) const;
     QueryWord ParseQueryWord(std::string_view text) const;
     Query ParseQueryNoDuplicates(std::string_view text) const;
     Query ParseQueryBasic(std::string_view text) const;
+    std::vector<int> GetTermIds(const std::vector<std::string_view>& words) const;
+    // an indexed word standing in for a pattern or a misspelled word
+    struct WordExpansion {
+        PostingMap::const_iterator word;
+        double weight;
+    };
+
+    bool IsIndexed(std::string_view word) const;
+    std::vector<WordExpansion> ExpandPattern(std::string_view pattern, size_t max_expansions) const;
+    std::vector<WordExpansion> ExpandFuzzy(std::string_view word) const;
+    Query ExpandQueryWords(Query query) const;
+    template <typename Ranking>
+    void AccumulateExpansionScores(const std::vector<WordExpansion>& expansions,
+        ScoreAccumulator& document_to_relevance, ScoreAccumulator& merge_buffer) const;
+    void ExcludePatternDocuments(const Query& query, ScoreAccumulator& document_to_relevance) const;
+    std::vector<int> GetRequiredTermIds(const std::vector<std::string_view>& words) const;
+    std::vector<std::string_view> OrderRarestFirst(const std::vector<std::string_view>& words) const;
+    void MatchWords(const std::vector<int>& plus_term_ids, const std::vector<int>& minus_term_ids,
+        const std::vector<int>& required_term_ids, const std::vector<std::vector<std::string_view>>& phrases,
+        int document_id, std::vector<std::string_view>& matched_words) const;
+    bool ContainsPhrase(int document_id, const std::vector<std::string_view>& phrase,
+        const std::vector<int>& phrase_term_ids) const;
+    bool ContainsPhrases(int document_id, const std::vector<std::vector<std::string_view>>& phrases) const;
+    // The collection of candidates polls should_stop as it goes; a stopped
+    // collection returns no documents, since its candidates are incomplete.
+    static bool NeverStop();
+    std::vector<int> FindPhraseDocuments(const std::vector<std::string_view>& phrase,
+        const std::function<bool()>& should_stop = NeverStop) const;
+    void KeepPhraseDocuments(const Query& query, ScoreAccumulator& document_to_relevance,
+        const std::function<bool()>& should_stop = NeverStop) const;
     double ComputeWordInverseDocumentFreq(std::string_view word) const;
-    template <typename DocumentPredicate>
+    double GetAverageDocumentLength() const;
+    template <typename Ranking>
+    void ScorePostings(const PostingList& postings, size_t first, size_t count,
+        double inverse_document_freq, double* scores) const;
+    static void SelectTopDocuments(std::vector<Document>& documents);
+    QueryAnalytics::Clock::time_point StartQueryTiming() const;
+    void RecordQuery(std::string_view raw_query, size_t result_count,
+        QueryAnalytics::Clock::time_point start_time) const;
+    static bool IsRankedBefore(const Document& lhs, const Document& rhs);
+    static ResultPage SelectPage(std::vector<Document>& documents, size_t skip_count, size_t page_size);
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(
         std::execution::sequenced_policy policy, 
         const Query& query,
         DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate, typename StopPredicate>
+    std::vector<Document> FindAllDocuments(
+        std::execution::sequenced_policy policy, 
+        const Query& query,
+        DocumentPredicate document_predicate,
+        StopPredicate should_stop) const;
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(
         std::execution::parallel_policy policy, 
         const Query& query,
         DocumentPredicate document_predicate) const;
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(
+        AdaptiveExecutionPolicy policy,
+        const Query& query,
+        DocumentPredicate document_predicate) const;
+    template <typename Ranking, typename DocumentPredicate, typename StopPredicate>
+    std::vector<Document> FindAllDocumentsPruned(const Query& query, DocumentPredicate document_predicate,
+        StopPredicate should_stop) const;
+    QueryPlan PlanQuery(const Query& query) const;
+    std::vector<int> FindCandidateDocuments(const Query& query,
+        const std::function<bool()>& should_stop = NeverStop) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> CollectDocuments(
+        const ScoreAccumulator& document_to_relevance,
+        DocumentPredicate document_predicate) const;
 };
 
 template <typename StringContainer>
@@ -120,127 +423,584 @@ SearchServer::SearchServer(const StringContainer& stop_words)
     }
 }
 
-template <typename DocumentPredicate, typename ExecutionPolicy>
+template <typename Ranking, typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(
     ExecutionPolicy policy, 
     std::string_view raw_query,
     DocumentPredicate document_predicate) const {
     using namespace std;
+    std::lock_guard index_guard(writer_sync_.index.readers);
+    const auto start_time = StartQueryTiming();
+    METRICS_TIMER(timer);
     const auto query = ParseQueryNoDuplicates(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-    sort(matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs) {
-             if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-    
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-
+    METRICS_CHECKPOINT(timer, Metric::QUERY_PARSE);
+    auto matched_documents = FindAllDocuments<Ranking>(policy, query, document_predicate);
+    METRICS_TIMER(sort_timer);
+    SelectTopDocuments(matched_documents);
+    METRICS_CHECKPOINT(sort_timer, Metric::RESULT_SORT);
+    RecordQuery(raw_query, matched_documents.size(), start_time);
     return matched_documents;
 }
 
- template <typename ExecutionPolicy>
+ template <typename Ranking, typename ExecutionPolicy>
  std::vector<Document> SearchServer::FindTopDocuments(
     ExecutionPolicy policy, 
     std::string_view raw_query, 
     DocumentStatus status) const{
-    return FindTopDocuments(policy, raw_query, 
+    return FindTopDocuments<Ranking>(policy, raw_query, 
                             [status](int document_id, DocumentStatus document_status, int rating) {
                                 return document_status == status;
                             });
  }
 
-template <typename ExecutionPolicy>
+template <typename Ranking, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(
     ExecutionPolicy policy, std::string_view raw_query) const {
-    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    return FindTopDocuments<Ranking>(policy, raw_query, DocumentStatus::ACTUAL);
     }
     
-template <typename DocumentPredicate>
+template <typename Ranking, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(
     std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, document_predicate);
+}
+
+template <typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, status);
+}
+
+template <typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
 template <typename DocumentPredicate>
+ResultPage SearchServer::FindTopDocumentsPage(
+    std::string_view raw_query,
+    const PageCursor& cursor,
+    size_t page_size,
+    DocumentPredicate document_predicate) const {
+    if (cursor.IsEnd()) {
+        return {{}, cursor};
+    }
+    std::lock_guard index_guard(writer_sync_.index.readers);
+    const auto start_time = StartQueryTiming();
+    const auto query = ParseQueryNoDuplicates(raw_query);
+    auto matched_documents = FindAllDocuments(std::execution::seq, query, document_predicate);
+    if (!cursor.is_start_) {
+        const Document boundary{cursor.id_, cursor.relevance_, cursor.rating_};
+        matched_documents.erase(
+            std::remove_if(matched_documents.begin(), matched_documents.end(),
+                           [&boundary](const Document& document) {
+                               return !IsRankedBefore(boundary, document);
+                           }),
+            matched_documents.end());
+    }
+    auto page = SelectPage(matched_documents, 0, page_size);
+    RecordQuery(raw_query, page.documents.size(), start_time);
+    return page;
+}
+
+template <typename DocumentPredicate>
+ResultPage SearchServer::FindTopDocumentsPage(
+    std::string_view raw_query,
+    size_t page_index,
+    size_t page_size,
+    DocumentPredicate document_predicate) const {
+    std::lock_guard index_guard(writer_sync_.index.readers);
+    const auto start_time = StartQueryTiming();
+    const auto query = ParseQueryNoDuplicates(raw_query);
+    auto matched_documents = FindAllDocuments(std::execution::seq, query, document_predicate);
+    auto page = SelectPage(matched_documents, page_index * page_size, page_size);
+    RecordQuery(raw_query, page.documents.size(), start_time);
+    return page;
+}
+
+// Scans the posting list of every distinct word of the batch once, adding its
+// contribution to all queries that use the word. Words are visited rarest
+// first, the same order a single query visits its own words, so the
+// relevances are bit-identical to running the queries one by one. The
+// predicate runs once per matched document after all words are merged.
+template <typename Ranking, typename DocumentPredicate>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(
+    const std::vector<std::string>& raw_queries,
+    DocumentPredicate document_predicate) const {
+    std::lock_guard index_guard(writer_sync_.index.readers);
+    const auto start_time = StartQueryTiming();
+    std::map<std::string_view, std::vector<size_t>> plus_word_to_queries;
+    std::map<std::string_view, std::vector<size_t>> minus_word_to_queries;
+    std::vector<Query> queries(raw_queries.size());
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        queries[i] = ParseQueryNoDuplicates(raw_queries[i]);
+        const auto& query = queries[i];
+        for (auto word : query.plus_words) {
+            plus_word_to_queries[word].push_back(i);
+        }
+        for (auto word : query.minus_words) {
+            minus_word_to_queries[word].push_back(i);
+        }
+    }
+
+    std::vector<std::string_view> batch_words;
+    for (const auto& [word, _] : plus_word_to_queries) {
+        batch_words.push_back(word);
+    }
+    std::vector<std::map<int, double>> document_to_relevance(raw_queries.size());
+    std::vector<double> scores;
+    for (auto word : OrderRarestFirst(batch_words)) {
+        const auto& query_indices = plus_word_to_queries.at(word);
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            continue;
+        }
+        const PostingList& postings = it->second;
+        scores.resize(postings.size());
+        ScorePostings<Ranking>(postings, 0, postings.size(),
+                               Ranking::ComputeInverseDocumentFreq(CountDocuments(), postings.size()),
+                               scores.data());
+        const int* document_ids = postings.GetDocumentIds();
+        for (size_t i = 0; i < postings.size(); ++i) {
+            for (size_t query_index : query_indices) {
+                document_to_relevance[query_index][document_ids[i]] += scores[i];
+            }
+        }
+    }
+
+    // misspelled words and patterns are rare, they are expanded for every
+    // query separately, in the order FindAllDocuments uses
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        ScoreAccumulator merge_buffer;
+        auto add_expansions = [&](const std::vector<WordExpansion>& expansions) {
+            ScoreAccumulator expansion_scores;
+            AccumulateExpansionScores<Ranking>(expansions, expansion_scores, merge_buffer);
+            for (const auto& [document_id, relevance] : expansion_scores) {
+                document_to_relevance[i][document_id] += relevance;
+            }
+        };
+        for (auto word : queries[i].plus_words) {
+            if (!IsIndexed(word)) {
+                add_expansions(ExpandFuzzy(word));
+            }
+        }
+        for (auto pattern : queries[i].plus_patterns) {
+            add_expansions(ExpandPattern(pattern, MAX_PATTERN_EXPANSIONS));
+        }
+    }
+
+    for (const auto& [word, query_indices] : minus_word_to_queries) {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings == word_to_document_freqs_.end()) {
+            continue;
+        }
+        for (const auto [document_id, _] : postings->second) {
+            for (size_t query_index : query_indices) {
+                document_to_relevance[query_index].erase(document_id);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        for (auto pattern : queries[i].minus_patterns) {
+            for (const auto& expansion : ExpandPattern(pattern, std::numeric_limits<size_t>::max())) {
+                for (const auto [document_id, _] : expansion.word->second) {
+                    document_to_relevance[i].erase(document_id);
+                }
+            }
+        }
+        if (!queries[i].required_words.empty()) {
+            const auto candidates = FindCandidateDocuments(queries[i]);
+            for (auto it = document_to_relevance[i].begin(); it != document_to_relevance[i].end();) {
+                if (std::binary_search(candidates.begin(), candidates.end(), it->first)) {
+                    ++it;
+                } else {
+                    it = document_to_relevance[i].erase(it);
+                }
+            }
+        }
+        for (const auto& phrase : queries[i].phrases) {
+            const auto phrase_documents = FindPhraseDocuments(phrase);
+            for (auto it = document_to_relevance[i].begin(); it != document_to_relevance[i].end();) {
+                if (std::binary_search(phrase_documents.begin(), phrase_documents.end(), it->first)) {
+                    ++it;
+                } else {
+                    it = document_to_relevance[i].erase(it);
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<Document>> result(raw_queries.size());
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        for (const auto [document_id, relevance] : document_to_relevance[i]) {
+            const auto metadata = documents_.at(document_id).GetMetadata();
+            if (document_predicate(document_id, metadata.status, metadata.rating)) {
+                result[i].push_back({document_id, relevance, metadata.rating});
+            }
+        }
+        SelectTopDocuments(result[i]);
+    }
+    if (analytics_ != nullptr && !raw_queries.empty()) {
+        // the batch shares its scans, so every query is charged an equal part
+        const auto latency = (QueryAnalytics::Clock::now() - start_time) / raw_queries.size();
+        for (size_t i = 0; i < raw_queries.size(); ++i) {
+            analytics_->Record(raw_queries[i], result[i].size(), latency);
+        }
+    }
+    return result;
+}
+
+template <typename Ranking>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(
+    const std::vector<std::string>& raw_queries, DocumentStatus status) const {
+    return FindTopDocumentsBatch<Ranking>(raw_queries, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+template <typename Ranking>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(
+    const std::vector<std::string>& raw_queries) const {
+    return FindTopDocumentsBatch<Ranking>(raw_queries, DocumentStatus::ACTUAL);
+}
+
+template <typename DocumentPredicate>
+std::future<SearchResult> SearchServer::FindTopDocumentsAsync(
+    std::string_view raw_query,
+    QueryBudget budget,
+    DocumentPredicate document_predicate,
+    TaskScheduler& scheduler) const {
+    auto promise = std::make_shared<std::promise<SearchResult>>();
+    auto result = promise->get_future();
+    scheduler.Submit(
+        [this, promise, budget, document_predicate, query_text = std::string{raw_query}] {
+            SearchResult search_result;
+            try {
+                std::lock_guard index_guard(writer_sync_.index.readers);
+                const auto start_time = StartQueryTiming();
+                const auto query = ParseQueryNoDuplicates(query_text);
+                search_result.documents = FindAllDocuments(
+                    std::execution::seq, query, document_predicate,
+                    [&budget, &search_result] {
+                        search_result.status = budget.Check();
+                        return search_result.status != QueryStatus::COMPLETE;
+                    });
+                SelectTopDocuments(search_result.documents);
+                RecordQuery(query_text, search_result.documents.size(), start_time);
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+                return;
+            }
+            // the server may be gone once the future is ready, so the read
+            // lock is released first
+            promise->set_value(std::move(search_result));
+        });
+    return result;
+}
+
+template <typename Ranking, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(
     std::execution::sequenced_policy policy, 
     const SearchServer::Query& query, 
     DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    return FindAllDocuments<Ranking>(policy, query, document_predicate, [] { return false; });
+}
+
+// should_stop is polled up front and once per POSTING_BLOCK_SIZE plus-word
+// postings; after it returns true the remaining plus-words are skipped.
+// Minus-words are always applied in full so partial results never contain
+// excluded documents, and a phrase check cut short keeps no documents at all.
+// Postings are scored a block at a time into a flat buffer and merged into a
+// sorted accumulator, rarest word first, so the accumulator stays small while
+// most words are merged; the predicate runs once per candidate document.
+template <typename Ranking, typename DocumentPredicate, typename StopPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(
+    std::execution::sequenced_policy policy, 
+    const SearchServer::Query& query, 
+    DocumentPredicate document_predicate,
+    StopPredicate should_stop) const {
+    // the candidates are bounded by the rarest required word
+    if (!query.required_words.empty()) {
+        return FindAllDocumentsPruned<Ranking>(query, document_predicate, should_stop);
+    }
+    METRICS_TIMER(timer);
+    ScoreAccumulator document_to_relevance;
+    ScoreAccumulator merge_buffer;
+    std::vector<double> scores;
+    std::vector<std::string_view> unknown_words;
+    size_t postings_left_in_block = POSTING_BLOCK_SIZE;
+    bool stopped = should_stop();
+    for (auto word : OrderRarestFirst(query.plus_words)) {
+        if (stopped) {
+            break;
+        }
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            unknown_words.push_back(word);
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        const PostingList& postings = it->second;
+        const double inverse_document_freq =
+            Ranking::ComputeInverseDocumentFreq(CountDocuments(), postings.size());
+        scores.resize(postings.size());
+        size_t scored_count = 0;
+        while (scored_count < postings.size()) {
+            const size_t block_size = std::min(postings.size() - scored_count, postings_left_in_block);
+            ScorePostings<Ranking>(postings, scored_count, block_size, inverse_document_freq,
+                                   scores.data() + scored_count);
+            scored_count += block_size;
+            postings_left_in_block -= block_size;
+            if (postings_left_in_block == 0) {
+                postings_left_in_block = POSTING_BLOCK_SIZE;
+                if (should_stop()) {
+                    stopped = true;
+                    break;
+                }
             }
         }
+        AccumulateScores(postings.GetDocumentIds(), scores.data(), scored_count,
+                         document_to_relevance, merge_buffer);
+    }
+    for (auto word : unknown_words) {
+        if (stopped || (stopped = should_stop())) {
+            break;
+        }
+        AccumulateExpansionScores<Ranking>(ExpandFuzzy(word), document_to_relevance, merge_buffer);
+    }
+    for (auto pattern : query.plus_patterns) {
+        if (stopped || (stopped = should_stop())) {
+            break;
+        }
+        AccumulateExpansionScores<Ranking>(ExpandPattern(pattern, MAX_PATTERN_EXPANSIONS),
+                                           document_to_relevance, merge_buffer);
     }
+    METRICS_CHECKPOINT(timer, Metric::POSTING_SCAN);
     
     for (auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end()) {
+            ExcludeDocuments(it->second, document_to_relevance);
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+    }
+    ExcludePatternDocuments(query, document_to_relevance);
+    KeepPhraseDocuments(query, document_to_relevance, should_stop);
+    METRICS_CHECKPOINT(timer, Metric::MINUS_WORD_EXCLUSION);
+
+    std::vector<Document> matched_documents = CollectDocuments(document_to_relevance, document_predicate);
+    METRICS_CHECKPOINT(timer, Metric::RESULT_MERGE);
+    return matched_documents;
+}
+
+// Words are scored in parallel, each into its own buffer, and merged rarest
+// first like in the sequential search, so the relevances are bit-identical.
+template <typename Ranking, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(
+    std::execution::parallel_policy,
+    const SearchServer::Query& query,
+    DocumentPredicate document_predicate) const {
+    if (!query.required_words.empty()) {
+        return FindAllDocumentsPruned<Ranking>(query, document_predicate, [] { return false; });
+    }
+    METRICS_TIMER(timer);
+    std::vector<const PostingList*> word_postings;
+    std::vector<double> inverse_document_freqs;
+    std::vector<std::string_view> unknown_words;
+    for (auto word : OrderRarestFirst(query.plus_words)) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+            word_postings.push_back(&it->second);
+            inverse_document_freqs.push_back(
+                Ranking::ComputeInverseDocumentFreq(CountDocuments(), it->second.size()));
+        } else {
+            unknown_words.push_back(word);
         }
     }
+    std::vector<std::vector<double>> word_scores(word_postings.size());
+    TaskScheduler::Instance().ParallelFor(
+             word_postings.size(),
+             [&](size_t index) {
+                 const PostingList& postings = *word_postings[index];
+                 word_scores[index].resize(postings.size());
+                 ScorePostings<Ranking>(postings, 0, postings.size(), inverse_document_freqs[index],
+                                        word_scores[index].data());
+             });
+    ScoreAccumulator document_to_relevance;
+    ScoreAccumulator merge_buffer;
+    for (size_t index = 0; index < word_postings.size(); ++index) {
+        AccumulateScores(word_postings[index]->GetDocumentIds(), word_scores[index].data(),
+                         word_scores[index].size(), document_to_relevance, merge_buffer);
+    }
+    for (auto word : unknown_words) {
+        AccumulateExpansionScores<Ranking>(ExpandFuzzy(word), document_to_relevance, merge_buffer);
+    }
+    for (auto pattern : query.plus_patterns) {
+        AccumulateExpansionScores<Ranking>(ExpandPattern(pattern, MAX_PATTERN_EXPANSIONS),
+                                           document_to_relevance, merge_buffer);
+    }
+    METRICS_CHECKPOINT(timer, Metric::POSTING_SCAN);
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+    for (auto word : query.minus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end()) {
+            ExcludeDocuments(it->second, document_to_relevance);
+        }
     }
+    ExcludePatternDocuments(query, document_to_relevance);
+    KeepPhraseDocuments(query, document_to_relevance);
+    METRICS_CHECKPOINT(timer, Metric::MINUS_WORD_EXCLUSION);
+
+    std::vector<Document> matched_documents = CollectDocuments(document_to_relevance, document_predicate);
+    METRICS_CHECKPOINT(timer, Metric::RESULT_MERGE);
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
+// Scores postings [first, first + count) into scores. Length-independent
+// policies multiply whole blocks in the vectorized kernel; the others read
+// document lengths stored next to the term frequencies.
+template <typename Ranking>
+void SearchServer::ScorePostings(const PostingList& postings, size_t first, size_t count,
+                                 double inverse_document_freq, double* scores) const {
+    if constexpr (Ranking::USES_DOCUMENT_LENGTH) {
+        const double average_document_length = GetAverageDocumentLength();
+        const int* document_lengths = postings.GetDocumentLengths() + first;
+        const StoredTermFreq* term_freqs = postings.GetTermFreqs() + first;
+        for (size_t i = 0; i < count; ++i) {
+            scores[i] = inverse_document_freq
+                * Ranking::ComputeTermWeight(term_freqs[i], document_lengths[i], average_document_length);
+        }
+    } else {
+        ScorePostingBlock(postings.GetTermFreqs() + first, count, inverse_document_freq, scores);
+    }
+}
+
+// The expansions are scored like ordinary words times their weight, united
+// into one list and merged into the accumulator once, not once per expansion.
+template <typename Ranking>
+void SearchServer::AccumulateExpansionScores(const std::vector<WordExpansion>& expansions,
+                                             ScoreAccumulator& document_to_relevance,
+                                             ScoreAccumulator& merge_buffer) const {
+    if (expansions.empty()) {
+        return;
+    }
+    std::vector<std::vector<double>> expansion_scores(expansions.size());
+    std::vector<ScoredPostings> scored_lists;
+    for (size_t i = 0; i < expansions.size(); ++i) {
+        const PostingList& postings = expansions[i].word->second;
+        expansion_scores[i].resize(postings.size());
+        ScorePostings<Ranking>(postings, 0, postings.size(),
+                               Ranking::ComputeInverseDocumentFreq(CountDocuments(), postings.size()),
+                               expansion_scores[i].data());
+        if (expansions[i].weight != 1.0) {
+            for (double& score : expansion_scores[i]) {
+                score *= expansions[i].weight;
+            }
+        }
+        scored_lists.push_back({postings.GetDocumentIds(), expansion_scores[i].data(), postings.size()});
+    }
+    std::vector<int> document_ids;
+    std::vector<double> scores;
+    UnionScores(scored_lists, document_ids, scores);
+    AccumulateScores(document_ids.data(), scores.data(), document_ids.size(), document_to_relevance, merge_buffer);
+}
+
+template <typename Ranking, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(
-    std::execution::parallel_policy policy, 
+    AdaptiveExecutionPolicy,
     const SearchServer::Query& query,
     DocumentPredicate document_predicate) const {
-    static constexpr int BUCKET_COUNT = 1000;
-    ConcurrentMap<int, double> par_document_to_relevance(BUCKET_COUNT);
-    for_each(policy,
-             query.plus_words.begin(),
-             query.plus_words.end(), 
-             [&](std::string_view word) {
-                 if (word_to_document_freqs_.count(word) != 0) {
-                     const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                     for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                         const auto& document_data = documents_.at(document_id);
-                         if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                             par_document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                         }
-                     }
-                 }
-             });
+    switch (PlanQuery(query).execution) {
+        case QueryExecution::PRUNED:
+            return FindAllDocumentsPruned<Ranking>(query, document_predicate, [] { return false; });
+        case QueryExecution::PARALLEL:
+            return FindAllDocuments<Ranking>(std::execution::par, query, document_predicate);
+        case QueryExecution::SEQUENTIAL:
+            break;
+    }
+    return FindAllDocuments<Ranking>(std::execution::seq, query, document_predicate);
+}
 
-    for_each(policy,
-             query.minus_words.begin(),
-             query.minus_words.end(),
-             [&](std::string_view word) {
-                 if (word_to_document_freqs_.count(word) != 0) {
-                     for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                         par_document_to_relevance.Erase(document_id);
-                     }
-                 }
-             });
+// Required words, phrases and minus-words fix the candidates before anything
+// is scored, and plus-word postings are only probed for them. Words are still
+// added rarest first, so the relevances are bit-identical to the sequential
+// search. should_stop is polled while the candidates are collected and before
+// every plus-word; a stopped search returns the candidates scored so far.
+template <typename Ranking, typename DocumentPredicate, typename StopPredicate>
+std::vector<Document> SearchServer::FindAllDocumentsPruned(const SearchServer::Query& query,
+                                                           DocumentPredicate document_predicate,
+                                                           StopPredicate should_stop) const {
+    METRICS_TIMER(timer);
+    const std::vector<int> candidates = FindCandidateDocuments(query, should_stop);
+    METRICS_CHECKPOINT(timer, Metric::MINUS_WORD_EXCLUSION);
+
+    ScoreAccumulator document_to_relevance;
+    ScoreAccumulator merge_buffer;
+    std::vector<int> document_ids;
+    std::vector<double> scores;
+    std::vector<std::string_view> unknown_words;
+    bool stopped = false;
+    for (auto word : OrderRarestFirst(query.plus_words)) {
+        if ((stopped = should_stop())) {
+            break;
+        }
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            unknown_words.push_back(word);
+            continue;
+        }
+        const PostingList& postings = it->second;
+        const double inverse_document_freq =
+            Ranking::ComputeInverseDocumentFreq(CountDocuments(), postings.size());
+        const int* const first = postings.GetDocumentIds();
+        const int* const last = first + postings.size();
+        const int* position = first;
+        document_ids.clear();
+        scores.clear();
+        for (const int document_id : candidates) {
+            position = std::lower_bound(position, last, document_id);
+            if (position == last) {
+                break;
+            }
+            if (*position == document_id) {
+                double score;
+                ScorePostings<Ranking>(postings, position - first, 1, inverse_document_freq, &score);
+                document_ids.push_back(document_id);
+                scores.push_back(score);
+            }
+        }
+        AccumulateScores(document_ids.data(), scores.data(), document_ids.size(),
+                         document_to_relevance, merge_buffer);
+    }
+    for (auto word : unknown_words) {
+        if (stopped || (stopped = should_stop())) {
+            break;
+        }
+        AccumulateExpansionScores<Ranking>(ExpandFuzzy(word), document_to_relevance, merge_buffer);
+    }
+    for (auto pattern : query.plus_patterns) {
+        if (stopped || (stopped = should_stop())) {
+            break;
+        }
+        AccumulateExpansionScores<Ranking>(ExpandPattern(pattern, MAX_PATTERN_EXPANSIONS),
+                                           document_to_relevance, merge_buffer);
+    }
+    KeepDocuments(candidates, document_to_relevance);
+    METRICS_CHECKPOINT(timer, Metric::POSTING_SCAN);
 
-    std::map<int, double> document_to_relevance = par_document_to_relevance.BuildOrdinaryMap();
+    std::vector<Document> matched_documents = CollectDocuments(document_to_relevance, document_predicate);
+    METRICS_CHECKPOINT(timer, Metric::RESULT_MERGE);
+    return matched_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::CollectDocuments(
+    const ScoreAccumulator& document_to_relevance,
+    DocumentPredicate document_predicate) const {
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+    for (const auto& [document_id, relevance] : document_to_relevance) {
+        const auto metadata = documents_.at(document_id).GetMetadata();
+        if (document_predicate(document_id, metadata.status, metadata.rating)) {
+            matched_documents.push_back({document_id, relevance, metadata.rating});
+        }
     }
     return matched_documents;
-}
\ No newline at end of file
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "standing_queries.h"
+
+using namespace std;
+
+int StandingQueryIndex::Add(const vector<string_view>& plus_words, const vector<string_view>& minus_words,
+                            const vector<string_view>& required_words,
+                            const vector<vector<string_view>>& phrases, DocumentStatus status,
+                            StandingQueryCallback callback) {
+    if (!callback) {
+        throw invalid_argument("Standing query needs a callback"s);
+    }
+    const int query_id = next_query_id_++;
+    QueryData query{{plus_words.begin(), plus_words.end()}, {minus_words.begin(), minus_words.end()}, {},
+                    required_words.size(), status, move(callback)};
+    for (const auto& phrase : phrases) {
+        query.phrases.emplace_back(phrase.begin(), phrase.end());
+    }
+    for (auto word : plus_words) {
+        const bool is_required = find(required_words.begin(), required_words.end(), word) != required_words.end();
+        plus_index_[string{word}].push_back({query_id, is_required});
+    }
+    for (auto word : minus_words) {
+        minus_index_[string{word}].push_back(query_id);
+    }
+    queries_.emplace(query_id, move(query));
+    return query_id;
+}
+
+void StandingQueryIndex::Remove(int query_id) {
+    const auto query = queries_.find(query_id);
+    if (query == queries_.end()) {
+        throw invalid_argument("Invalid standing query id"s);
+    }
+    for (const auto& word : query->second.plus_words) {
+        const auto entries = plus_index_.find(word);
+        auto& ids = entries->second;
+        ids.erase(remove_if(ids.begin(), ids.end(),
+                            [query_id](const PlusEntry& entry) {
+                                return entry.query_id == query_id;
+                            }),
+                  ids.end());
+        if (ids.empty()) {
+            plus_index_.erase(entries);
+        }
+    }
+    for (const auto& word : query->second.minus_words) {
+        const auto entries = minus_index_.find(word);
+        auto& ids = entries->second;
+        ids.erase(remove(ids.begin(), ids.end(), query_id), ids.end());
+        if (ids.empty()) {
+            minus_index_.erase(entries);
+        }
+    }
+    queries_.erase(query);
+}
+
+void StandingQueryIndex::Percolate(int document_id, const vector<string_view>& words, DocumentStatus status) const {
+    if (queries_.empty()) {
+        return;
+    }
+    vector<string_view> distinct_words = words;
+    sort(distinct_words.begin(), distinct_words.end());
+    distinct_words.erase(unique(distinct_words.begin(), distinct_words.end()), distinct_words.end());
+
+    vector<PlusEntry> hits;
+    vector<int> excluded;
+    for (auto word : distinct_words) {
+        if (const auto entries = plus_index_.find(word); entries != plus_index_.end()) {
+            hits.insert(hits.end(), entries->second.begin(), entries->second.end());
+        }
+        if (const auto ids = minus_index_.find(word); ids != minus_index_.end()) {
+            excluded.insert(excluded.end(), ids->second.begin(), ids->second.end());
+        }
+    }
+    sort(hits.begin(), hits.end(), [](const PlusEntry& lhs, const PlusEntry& rhs) {
+        return lhs.query_id < rhs.query_id;
+    });
+    sort(excluded.begin(), excluded.end());
+
+    for (auto it = hits.begin(); it != hits.end();) {
+        const int query_id = it->query_id;
+        size_t required_hits = 0;
+        for (; it != hits.end() && it->query_id == query_id; ++it) {
+            required_hits += it->is_required ? 1 : 0;
+        }
+        const QueryData& query = queries_.at(query_id);
+        if (query.status != status || required_hits != query.required_count
+            || binary_search(excluded.begin(), excluded.end(), query_id)) {
+            continue;
+        }
+        const bool has_phrases = all_of(query.phrases.begin(), query.phrases.end(),
+                                        [&words](const vector<string>& phrase) {
+                                            return search(words.begin(), words.end(), phrase.begin(),
+                                                          phrase.end()) != words.end();
+                                        });
+        if (has_phrases) {
+            query.callback(query_id, document_id);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// Called with the query id and the id of a newly added document it matches.
+using StandingQueryCallback = std::function<void(int query_id, int document_id)>;
+
+// Percolator: registered queries indexed by their words, so a new document
+// is matched by looking up its own distinct words, and the cost follows the
+// document and the queries sharing its words, not the number of queries.
+// A document matches a query if it contains a plus-word, every required
+// word and every phrase, no minus-word, and has the query's status.
+class StandingQueryIndex {
+public:
+    // Words are parsed already: stop words dropped, duplicates erased.
+    int Add(const std::vector<std::string_view>& plus_words, const std::vector<std::string_view>& minus_words,
+        const std::vector<std::string_view>& required_words,
+        const std::vector<std::vector<std::string_view>>& phrases, DocumentStatus status,
+        StandingQueryCallback callback);
+    void Remove(int query_id);
+
+    // Runs the callbacks of the queries the document matches, in ascending
+    // order of query id. `words` are the document's words in text order.
+    void Percolate(int document_id, const std::vector<std::string_view>& words, DocumentStatus status) const;
+
+    bool empty() const {
+        return queries_.empty();
+    }
+
+    size_t size() const {
+        return queries_.size();
+    }
+
+private:
+    struct QueryData {
+        std::vector<std::string> plus_words;
+        std::vector<std::string> minus_words;
+        std::vector<std::vector<std::string>> phrases;
+        size_t required_count;
+        DocumentStatus status;
+        StandingQueryCallback callback;
+    };
+
+    struct PlusEntry {
+        int query_id;
+        bool is_required;
+    };
+
+    std::map<int, QueryData> queries_;
+    std::map<std::string, std::vector<PlusEntry>, std::less<>> plus_index_;
+    std::map<std::string, std::vector<int>, std::less<>> minus_index_;
+    int next_query_id_ = 0;
+};
@@ -37,4 +37,25 @@ vector<string_view> SplitIntoWordsView(string_view str) {
     }
 
     return result;
-} 
\ No newline at end of file
+}
+
+uint64_t MixHash(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// FNV-1a followed by the finalizer, so that nearby seeds give
+// independent-looking hashes.
+uint64_t HashWord(string_view word, uint64_t seed) {
+    uint64_t hash = seed;
+    for (const char c : word) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= word.size();
+    return MixHash(hash);
+}
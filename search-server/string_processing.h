@@ -2,9 +2,14 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <cstdint>
+#include <string_view>
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
+// splitmix64 finalizer: spreads every input bit over the whole result
+std::uint64_t MixHash(std::uint64_t x);
+std::uint64_t HashWord(std::string_view word, std::uint64_t seed);
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <utility>
+
+#include <stdexcept>
+
+#include "numa_topology.h"
+#include "task_scheduler.h"
+
+using namespace std;
+
+namespace {
+thread_local const TaskScheduler* current_scheduler = nullptr;
+thread_local size_t current_worker_index = 0;
+
+mutex default_placement_mutex;
+TaskScheduler::ThreadPlacement default_placement = TaskScheduler::ThreadPlacement::ANY_CPU;
+bool shared_pool_started = false;
+
+TaskScheduler::ThreadPlacement StartSharedPool() {
+    lock_guard guard(default_placement_mutex);
+    shared_pool_started = true;
+    return default_placement;
+}
+}
+
+TaskScheduler::TaskScheduler(size_t thread_count, ThreadPlacement placement) {
+    thread_count = max<size_t>(thread_count, 1);
+    queues_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(make_unique<WorkerQueue>());
+    }
+
+    const auto node_cpus = placement == ThreadPlacement::NUMA_NODES
+        ? GetNumaNodeCpus() : vector<vector<int>>(1);
+    auto node_of = [&](size_t worker) {
+        return worker % node_cpus.size();
+    };
+    steal_orders_.resize(thread_count + 1);
+    for (size_t self = 0; self < thread_count; ++self) {
+        auto& order = steal_orders_[self];
+        for (size_t offset = 1; offset < thread_count; ++offset) {
+            order.push_back((self + offset) % thread_count);
+        }
+        stable_partition(order.begin(), order.end(), [&](size_t victim) {
+            return node_of(victim) == node_of(self);
+        });
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        steal_orders_.back().push_back(i);
+    }
+
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this, i, cpus = node_cpus[node_of(i)]]() mutable {
+            WorkerLoop(i, move(cpus));
+        });
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        lock_guard guard(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+TaskScheduler& TaskScheduler::Instance() {
+    static TaskScheduler scheduler(thread::hardware_concurrency(), StartSharedPool());
+    return scheduler;
+}
+
+void TaskScheduler::SetDefaultPlacement(ThreadPlacement placement) {
+    lock_guard guard(default_placement_mutex);
+    if (shared_pool_started) {
+        throw logic_error("Shared task scheduler is already running"s);
+    }
+    default_placement = placement;
+}
+
+size_t TaskScheduler::GetThreadCount() const {
+    return workers_.size();
+}
+
+void TaskScheduler::Submit(function<void()> task) {
+    Push(move(task));
+}
+
+size_t TaskScheduler::GetLocalQueueIndex() {
+    if (current_scheduler == this) {
+        return current_worker_index;
+    }
+    return next_queue_.fetch_add(1, memory_order_relaxed) % queues_.size();
+}
+
+void TaskScheduler::Push(Task task) {
+    // Counted before it becomes visible, so pending_ never underflows when
+    // the task is stolen right after the push.
+    pending_.fetch_add(1);
+    auto& queue = *queues_[GetLocalQueueIndex()];
+    {
+        lock_guard guard(queue.mutex);
+        queue.tasks.push_back(move(task));
+    }
+    // A worker counts itself in sleeping_ before it checks pending_, and the
+    // push counts pending_ before it checks sleeping_, so either the worker
+    // sees the task or the push sees the worker.
+    if (sleeping_.load() > 0) {
+        lock_guard guard(sleep_mutex_);
+        wake_.notify_one();
+    }
+}
+
+bool TaskScheduler::TryRunOne() {
+    Task task;
+    const bool is_worker = current_scheduler == this;
+    const size_t self = is_worker ? current_worker_index : queues_.size();
+
+    if (is_worker) {
+        auto& own = *queues_[self];
+        lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+    for (const size_t victim_index : steal_orders_[self]) {
+        if (task) {
+            break;
+        }
+        auto& victim = *queues_[victim_index];
+        lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+    pending_.fetch_sub(1, memory_order_acq_rel);
+    task();
+    return true;
+}
+
+void TaskScheduler::WorkerLoop(size_t index, vector<int> cpus) {
+    if (!cpus.empty()) {
+        PinThreadToCpus(cpus);
+    }
+    current_scheduler = this;
+    current_worker_index = index;
+    while (true) {
+        if (TryRunOne()) {
+            continue;
+        }
+        unique_lock lock(sleep_mutex_);
+        sleeping_.fetch_add(1);
+        wake_.wait(lock, [this] {
+            return stop_ || pending_.load() > 0;
+        });
+        sleeping_.fetch_sub(1);
+        // queued tasks are still run after stop_ is set
+        if (stop_ && pending_.load() == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool shared by SearchServer and ProcessQueries.
+// Every worker owns a deque: it pushes and pops its own tasks from the back,
+// idle workers steal from the front of the others. ParallelFor shares its
+// indices between the caller and helper tasks; the caller runs indices until
+// none are left and then sleeps until the helpers are done, never picking up
+// unrelated tasks. Every caller works through its own range, so nested calls
+// always make progress and spawn no extra threads.
+class TaskScheduler {
+public:
+    enum class ThreadPlacement {
+        // Workers run wherever the operating system puts them.
+        ANY_CPU,
+        // Worker i is pinned to the CPUs of NUMA node i % node_count and
+        // steals from workers of its own node before crossing nodes.
+        NUMA_NODES,
+    };
+
+    explicit TaskScheduler(size_t thread_count = std::thread::hardware_concurrency(),
+                           ThreadPlacement placement = ThreadPlacement::ANY_CPU);
+    // Runs the tasks still queued, then joins the workers.
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    static TaskScheduler& Instance();
+
+    // Placement of the pool returned by Instance(). Throws std::logic_error
+    // once that pool has been started.
+    static void SetDefaultPlacement(ThreadPlacement placement);
+
+    size_t GetThreadCount() const;
+
+    // Queues a task without waiting for it. The task must not throw.
+    void Submit(std::function<void()> task);
+
+    // Calls func(i) for every i in [0, task_count) and waits for completion.
+    // If calls throw, one of the exceptions is rethrown in the caller once
+    // all calls are done.
+    template <typename Func>
+    void ParallelFor(size_t task_count, Func func);
+
+private:
+    using Task = std::function<void()>;
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void Push(Task task);
+    bool TryRunOne();
+    void WorkerLoop(size_t index, std::vector<int> cpus);
+    size_t GetLocalQueueIndex();
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    // Queues a worker steals from, in order; the last entry is used by
+    // threads outside the pool and lists every queue.
+    std::vector<std::vector<size_t>> steal_orders_;
+    std::vector<std::thread> workers_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<size_t> pending_{0};
+    // workers parked on wake_; a push only notifies when there are any
+    std::atomic<size_t> sleeping_{0};
+    std::atomic<size_t> next_queue_{0};
+    bool stop_ = false;
+};
+
+template <typename Func>
+void TaskScheduler::ParallelFor(size_t task_count, Func func) {
+    if (task_count == 0) {
+        return;
+    }
+    if (task_count == 1) {
+        func(size_t{0});
+        return;
+    }
+
+    // Helpers that start after the last index is claimed find nothing to do,
+    // possibly after the call has returned, so the state is shared with them.
+    struct State {
+        std::atomic<size_t> next_index{0};
+        size_t remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    state->remaining = task_count;
+    auto run_claimed = [state, task_count, &func] {
+        size_t finished = 0;
+        std::exception_ptr error;
+        for (size_t index; (index = state->next_index.fetch_add(1, std::memory_order_relaxed)) < task_count;) {
+            try {
+                func(index);
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            ++finished;
+        }
+        if (finished == 0) {
+            return;
+        }
+        std::lock_guard guard(state->mutex);
+        if (error && !state->error) {
+            state->error = error;
+        }
+        state->remaining -= finished;
+        if (state->remaining == 0) {
+            state->done.notify_all();
+        }
+    };
+
+    const size_t helper_count = std::min(task_count - 1, workers_.size());
+    for (size_t i = 0; i < helper_count; ++i) {
+        Push(run_claimed);
+    }
+    run_claimed();
+
+    std::unique_lock lock(state->mutex);
+    state->done.wait(lock, [&state] {
+        return state->remaining == 0;
+    });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+#include "term_dictionary.h"
+#include "levenshtein_automaton.h"
+#include "memory_usage.h"
+
+using namespace std;
+
+namespace {
+constexpr size_t MIN_MERGE_SIZE = 256;
+
+bool IsContinuationByte(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// The smallest string greater than every string starting with prefix;
+// empty if there is none.
+string GetPrefixSuccessor(string_view prefix) {
+    string successor{prefix};
+    while (!successor.empty() && static_cast<unsigned char>(successor.back()) == 0xFF) {
+        successor.pop_back();
+    }
+    if (!successor.empty()) {
+        ++successor.back();
+    }
+    return successor;
+}
+
+// Walks words in ascending order. seek(it, successor) returns the first
+// position at or after it whose word is not less than successor, or last.
+template <typename Iterator, typename GetWord, typename Seek, typename OnMatch>
+void WalkLevenshtein(const LevenshteinAutomaton& automaton, Iterator first, Iterator last,
+                     GetWord get_word, Seek seek, OnMatch on_match) {
+    // states[k] is the state after the first k code points of path
+    vector<LevenshteinAutomaton::State> states = {automaton.Start()};
+    vector<size_t> offsets = {0};
+    string_view path;
+    for (Iterator it = first; it != last;) {
+        const string_view word = get_word(it);
+        const size_t common = mismatch(word.begin(), word.begin() + min(word.size(), path.size()), path.begin())
+                                  .first - word.begin();
+        while (offsets.back() > common) {
+            states.pop_back();
+            offsets.pop_back();
+        }
+        path = word;
+        bool rejected = !automaton.CanMatch(states.back());
+        while (!rejected && offsets.back() < word.size()) {
+            const auto [code_point, length] = DecodeUtf8(word, offsets.back());
+            states.push_back(automaton.Step(states.back(), code_point));
+            offsets.push_back(offsets.back() + length);
+            rejected = !automaton.CanMatch(states.back());
+        }
+        if (!rejected) {
+            if (automaton.IsMatch(states.back())) {
+                on_match(it, automaton.GetDistance(states.back()));
+            }
+            ++it;
+            continue;
+        }
+        const string successor = GetPrefixSuccessor(word.substr(0, offsets.back()));
+        if (successor.empty()) {
+            break;
+        }
+        it = seek(it, successor);
+    }
+}
+}
+
+int TermDictionary::GetOrAdd(string_view word) {
+    const int term_id = Find(word);
+    if (term_id != NO_TERM) {
+        return term_id;
+    }
+    const int new_id = static_cast<int>(terms_.size());
+    terms_.push_back(word);
+    recent_.emplace(word, new_id);
+    if (recent_.size() >= max(MIN_MERGE_SIZE, sorted_ids_.size() / 8)) {
+        MergeRecent();
+    }
+    return new_id;
+}
+
+int TermDictionary::Find(string_view word) const {
+    const auto it = lower_bound(sorted_ids_.begin(), sorted_ids_.end(), word,
+                                [this](int term_id, string_view value) {
+                                    return terms_[term_id] < value;
+                                });
+    if (it != sorted_ids_.end() && terms_[*it] == word) {
+        return *it;
+    }
+    const auto recent = recent_.find(word);
+    return recent == recent_.end() ? NO_TERM : recent->second;
+}
+
+vector<int> TermDictionary::FindByPrefix(string_view prefix) const {
+    auto starts_with_prefix = [prefix](string_view word) {
+        return word.substr(0, prefix.size()) == prefix;
+    };
+    vector<int> found;
+    auto sorted = lower_bound(sorted_ids_.begin(), sorted_ids_.end(), prefix,
+                              [this](int term_id, string_view value) {
+                                  return terms_[term_id] < value;
+                              });
+    auto recent = recent_.lower_bound(prefix);
+    // merge the two ranges so that the result stays in word order
+    while (true) {
+        const bool has_sorted = sorted != sorted_ids_.end() && starts_with_prefix(terms_[*sorted]);
+        const bool has_recent = recent != recent_.end() && starts_with_prefix(recent->first);
+        if (has_sorted && (!has_recent || terms_[*sorted] < recent->first)) {
+            found.push_back(*sorted++);
+        } else if (has_recent) {
+            found.push_back(recent->second);
+            ++recent;
+        } else {
+            break;
+        }
+    }
+    return found;
+}
+
+vector<int> TermDictionary::FindByPattern(string_view pattern) const {
+    const string_view prefix = pattern.substr(0, pattern.find_first_of("*?"sv));
+    vector<int> found = FindByPrefix(prefix);
+    if (prefix.size() < pattern.size()) {
+        found.erase(remove_if(found.begin(), found.end(),
+                              [this, pattern](int term_id) {
+                                  return !MatchesPattern(terms_[term_id], pattern);
+                              }),
+                    found.end());
+    }
+    return found;
+}
+
+vector<pair<int, int>> TermDictionary::FindFuzzy(string_view word, int max_distance) const {
+    const LevenshteinAutomaton automaton(word, max_distance);
+    vector<pair<int, int>> sorted_found;
+    WalkLevenshtein(
+        automaton, sorted_ids_.begin(), sorted_ids_.end(),
+        [this](vector<int>::const_iterator it) {
+            return terms_[*it];
+        },
+        [this](vector<int>::const_iterator it, const string& successor) {
+            return lower_bound(it, sorted_ids_.end(), string_view{successor},
+                               [this](int term_id, string_view value) {
+                                   return terms_[term_id] < value;
+                               });
+        },
+        [&sorted_found](vector<int>::const_iterator it, int distance) {
+            sorted_found.push_back({*it, distance});
+        });
+    vector<pair<int, int>> recent_found;
+    WalkLevenshtein(
+        automaton, recent_.begin(), recent_.end(),
+        [](map<string_view, int>::const_iterator it) {
+            return it->first;
+        },
+        [this](map<string_view, int>::const_iterator, const string& successor) {
+            return recent_.lower_bound(string_view{successor});
+        },
+        [&recent_found](map<string_view, int>::const_iterator it, int distance) {
+            recent_found.push_back({it->second, distance});
+        });
+
+    vector<pair<int, int>> found;
+    merge(sorted_found.begin(), sorted_found.end(), recent_found.begin(), recent_found.end(),
+          back_inserter(found),
+          [this](const pair<int, int>& lhs, const pair<int, int>& rhs) {
+              return terms_[lhs.first] < terms_[rhs.first];
+          });
+    return found;
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    return terms_.capacity() * sizeof(string_view) + sorted_ids_.capacity() * sizeof(int)
+        + recent_.size() * (MAP_NODE_OVERHEAD + sizeof(pair<const string_view, int>));
+}
+
+void TermDictionary::MergeRecent() {
+    vector<int> merged;
+    merged.reserve(sorted_ids_.size() + recent_.size());
+    auto recent = recent_.begin();
+    for (const int term_id : sorted_ids_) {
+        for (; recent != recent_.end() && recent->first < terms_[term_id]; ++recent) {
+            merged.push_back(recent->second);
+        }
+        merged.push_back(term_id);
+    }
+    for (; recent != recent_.end(); ++recent) {
+        merged.push_back(recent->second);
+    }
+    sorted_ids_ = move(merged);
+    recent_.clear();
+}
+
+// Greedy glob matching with backtracking to the last '*'.
+bool MatchesPattern(string_view word, string_view pattern) {
+    size_t w = 0;
+    size_t p = 0;
+    size_t star = string_view::npos;
+    size_t star_word = 0;
+    while (w < word.size()) {
+        if (p < pattern.size() && pattern[p] == '?') {
+            // one code point: the lead byte and its continuation bytes
+            ++w;
+            while (w < word.size() && IsContinuationByte(word[w])) {
+                ++w;
+            }
+            ++p;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            star_word = w;
+        } else if (p < pattern.size() && pattern[p] == word[w]) {
+            ++w;
+            ++p;
+        } else if (star != string_view::npos) {
+            // let the last '*' swallow one more code point
+            p = star + 1;
+            do {
+                ++star_word;
+            } while (star_word < word.size() && IsContinuationByte(word[star_word]));
+            w = star_word;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+bool IsPattern(string_view word) {
+    return word.find_first_of("*?"sv) != string_view::npos;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Maps words to dense ids and enumerates words by prefix or wildcard pattern.
+// The words themselves stay where the caller keeps them (SearchServer's
+// document storage); the dictionary holds their views by id plus the ids
+// sorted by word, four bytes per word. Words added since the last merge wait
+// in a small map and are merged into the sorted array once it grows past an
+// eighth of the array, so insertion stays amortized O(log n).
+class TermDictionary {
+public:
+    static constexpr int NO_TERM = -1;
+
+    // The view must stay valid while the dictionary is alive.
+    int GetOrAdd(std::string_view word);
+    int Find(std::string_view word) const;
+
+    std::string_view GetTerm(int term_id) const {
+        return terms_[term_id];
+    }
+
+    // Words by id.
+    const std::vector<std::string_view>& GetTerms() const {
+        return terms_;
+    }
+
+    size_t size() const {
+        return terms_.size();
+    }
+
+    // Ids of the words starting with prefix, in word order.
+    std::vector<int> FindByPrefix(std::string_view prefix) const;
+    // Ids of the words matching the pattern, in word order. '*' matches any
+    // run of characters and '?' one character (UTF-8 code point). Only the
+    // words sharing the pattern's literal prefix are examined.
+    std::vector<int> FindByPattern(std::string_view pattern) const;
+
+    // Ids of the words within max_distance edits of the given one, paired
+    // with their distance, in word order. A Levenshtein automaton walks the
+    // sorted words sharing rows along common prefixes and skips the range of
+    // every prefix it rejects, so most of the dictionary is never touched.
+    std::vector<std::pair<int, int>> FindFuzzy(std::string_view word, int max_distance) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    void MergeRecent();
+
+    std::vector<std::string_view> terms_;
+    std::vector<int> sorted_ids_;
+    std::map<std::string_view, int> recent_;
+};
+
+// True if the word matches a pattern of '*' and '?' wildcards.
+bool MatchesPattern(std::string_view word, std::string_view pattern);
+bool IsPattern(std::string_view word);
@@ -1,10 +1,31 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <map>
+#include <set>
+#include <numeric>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <chrono>
 
 #include "test_example_functions.h"
 #include "search_server.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "query_analytics.h"
+#include "metrics.h"
 #include "document.h"
+#include "term_dictionary.h"
+#include "corpus_loader.h"
+#include "scoring_kernel.h"
+#include "numa_topology.h"
 
 using namespace std;
 
@@ -64,6 +85,602 @@ void TestDocumentsWithMinusWordsExcludedFromSearchResults() {
     ASSERT_EQUAL(doc0.id, doc_id_1);
 }
 
+void TestGetWordFrequencies() {
+    SearchServer server("in the"s);
+    server.AddDocument(42, "cat in the city of cats and cat"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    server.AddDocument(43, "the in"s, DocumentStatus::ACTUAL, {1});
+    
+    map<string_view, double> word_freqs;
+    for (const auto& [word, freq] : server.GetWordFrequencies(42)) {
+        word_freqs[word] = freq;
+    }
+    const map<string_view, double> expected = {
+        {"and"sv, 1. / 6}, {"cat"sv, 2. / 6}, {"cats"sv, 1. / 6}, {"city"sv, 1. / 6}, {"of"sv, 1. / 6}};
+    ASSERT_EQUAL(word_freqs.size(), expected.size());
+    for (const auto& [word, freq] : expected) {
+        ASSERT(abs(word_freqs.at(word) - freq) < 1e-9);
+    }
+    ASSERT_EQUAL(server.GetWordFrequencies(42).size(), 5u);
+    ASSERT(server.GetWordFrequencies(43).empty());
+    ASSERT(server.GetWordFrequencies(44).empty());
+}
+
+void TestPhraseQueries() {
+    auto make_server = [] {
+        SearchServer server("и в на"s);
+        server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+        server.AddDocument(1, "модный белый ошейник кот"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+        server.AddDocument(2, "кот белый кот и ошейник"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+        return server;
+    };
+    auto get_ids = [](const vector<Document>& documents) {
+        vector<int> ids;
+        for (const auto& document : documents) {
+            ids.push_back(document.id);
+        }
+        sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    SearchServer plain_server = make_server();
+    SearchServer positional_server = make_server();
+    positional_server.EnablePositionalIndex();
+    positional_server.AddDocument(3, "пёс и белый кот"s, DocumentStatus::ACTUAL, {1});
+    plain_server.AddDocument(3, "пёс и белый кот"s, DocumentStatus::ACTUAL, {1});
+    for (const SearchServer* server : {&plain_server, &positional_server}) {
+        ASSERT_EQUAL(get_ids(server->FindTopDocuments("\"белый кот\""s)), (vector<int>{0, 2, 3}));
+        // stop words do not break a phrase
+        ASSERT_EQUAL(get_ids(server->FindTopDocuments("\"кот и ошейник\""s)), (vector<int>{2}));
+        ASSERT_EQUAL(get_ids(server->FindTopDocuments("\"белый кот\" -пёс"s)), (vector<int>{0, 2}));
+        ASSERT_EQUAL(get_ids(server->FindTopDocuments(execution::par, "\"модный ошейник\""s)), (vector<int>{0}));
+        ASSERT(server->FindTopDocuments("\"ошейник модный\""s).empty());
+        // a one-word phrase is an ordinary word
+        ASSERT_EQUAL(server->FindTopDocuments("\"пёс\""s).size(), 1u);
+        ASSERT_EQUAL(server->FindTopDocumentsBatch({"\"белый кот\" ошейник"s})[0].size(), 3u);
+        // document 1 has both words, but apart
+        ASSERT(get<0>(server->MatchDocument("\"белый кот\""s, 1)).empty());
+        ASSERT(get<0>(server->MatchDocument(execution::par, "\"белый кот\""s, 1)).empty());
+        ASSERT_EQUAL(get<0>(server->MatchDocument("\"белый кот\""s, 0)).size(), 2u);
+        const auto matched = server->MatchDocuments("\"белый кот\""s, {0, 1});
+        ASSERT_EQUAL(matched.offsets[1], 2u);
+        ASSERT_EQUAL(matched.offsets[2], 2u);
+    }
+    try {
+        plain_server.FindTopDocuments("\"белый кот"s);
+        ASSERT_HINT(false, "unclosed phrase must throw"s);
+    } catch (const invalid_argument&) {
+    }
+
+    ASSERT_EQUAL(plain_server.GetIndexMemoryUsage().positions, 0u);
+    ASSERT(positional_server.GetIndexMemoryUsage().positions > 0);
+    positional_server.RemoveDocument(2);
+    ASSERT_EQUAL(get_ids(positional_server.FindTopDocuments("\"белый кот\""s)), (vector<int>{0, 3}));
+}
+
+void TestTermDictionary() {
+    vector<string> words;
+    for (int i = 0; i < 1000; ++i) {
+        words.push_back("w"s + to_string(i));
+    }
+    words.push_back("кот"s);
+    words.push_back("котёнок"s);
+    words.push_back("кит"s);
+    TermDictionary dictionary;
+    for (const auto& word : words) {
+        dictionary.GetOrAdd(word);
+    }
+    ASSERT_EQUAL(dictionary.size(), words.size());
+    ASSERT_EQUAL(dictionary.GetOrAdd(words[500]), 500);
+    ASSERT_EQUAL(dictionary.Find("w999"sv), 999);
+    ASSERT_EQUAL(dictionary.Find("кот"sv), 1000);
+    ASSERT_EQUAL(dictionary.Find("пёс"sv), TermDictionary::NO_TERM);
+
+    ASSERT_EQUAL(dictionary.FindByPrefix("w99"sv), (vector<int>{99, 990, 991, 992, 993, 994, 995, 996, 997, 998, 999}));
+    ASSERT_EQUAL(dictionary.FindByPrefix("кот"sv), (vector<int>{1000, 1001}));
+    ASSERT_EQUAL(dictionary.FindByPattern("к?т"sv), (vector<int>{1002, 1000}));
+    ASSERT_EQUAL(dictionary.FindByPattern("w*9"sv).size(), 100u);
+    ASSERT_EQUAL(dictionary.FindByPattern("*ёнок"sv), (vector<int>{1001}));
+    ASSERT(MatchesPattern("котёнок"sv, "к*т*к"sv));
+    ASSERT(!MatchesPattern("кот"sv, "к?"sv));
+}
+
+void TestPatternQueries() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    server.AddDocument(1, "пушистый котёнок пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+    server.AddDocument(3, "кит в море"s, DocumentStatus::ACTUAL, {1});
+
+    ASSERT_EQUAL(server.FindTopDocuments("кот*"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments(execution::par, "к?т"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments("кот* -пушист*"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("кот* -пушист*"s)[0].id, 0);
+    // a pattern scores as the sum of its words
+    const auto by_pattern = server.FindTopDocuments("кот*"s);
+    const auto by_words = server.FindTopDocuments("кот котёнок"s);
+    for (size_t i = 0; i < by_words.size(); ++i) {
+        ASSERT_EQUAL(by_pattern[i].id, by_words[i].id);
+        ASSERT_EQUAL(by_pattern[i].relevance, by_words[i].relevance);
+    }
+    ASSERT_EQUAL(server.FindTopDocumentsBatch({"кот* -пушист*"s})[0].size(), 1u);
+
+    const auto [words, status] = server.MatchDocument("к?т ошейник"s, 0);
+    ASSERT_EQUAL(words, (vector<string_view>{"кот"sv, "ошейник"sv}));
+    ASSERT(get<0>(server.MatchDocument("белый -мод*"s, 0)).empty());
+}
+
+void TestFuzzySearch() {
+    {
+        TermDictionary dictionary;
+        const int kit = dictionary.GetOrAdd("кит"sv);
+        const int kot = dictionary.GetOrAdd("кот"sv);
+        dictionary.GetOrAdd("кто"sv);
+        dictionary.GetOrAdd("котёнок"sv);
+        const int kom = dictionary.GetOrAdd("ком"sv);
+        // a transposition is two edits
+        ASSERT_EQUAL(dictionary.FindFuzzy("кот"sv, 1), (vector<pair<int, int>>{{kit, 1}, {kom, 1}, {kot, 0}}));
+        ASSERT_EQUAL(dictionary.FindFuzzy("котенок"sv, 1).size(), 1u);
+        ASSERT(dictionary.FindFuzzy("собака"sv, 2).empty());
+    }
+
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    server.AddDocument(1, "пушистый котёнок пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+    ASSERT(server.FindTopDocuments("пушыстый"s).empty());
+
+    server.EnableFuzzySearch({2, 0.5, 16});
+    const auto exact = server.FindTopDocuments("пушистый"s);
+    const auto corrected = server.FindTopDocuments("пушыстый"s);
+    ASSERT_EQUAL(corrected.size(), 1u);
+    ASSERT_EQUAL(corrected[0].id, 1);
+    ASSERT(abs(corrected[0].relevance - exact[0].relevance * 0.5) < 1e-6);
+    ASSERT_EQUAL(server.FindTopDocuments(execution::par, "пушыстый"s)[0].relevance, corrected[0].relevance);
+    ASSERT_EQUAL(server.FindTopDocumentsBatch({"пушыстый"s})[0][0].relevance, corrected[0].relevance);
+    // short words are too ambiguous to correct
+    ASSERT(server.FindTopDocuments("пс"s).empty());
+    ASSERT_EQUAL(get<0>(server.MatchDocument("пушыстый хвост"s, 1)),
+                 (vector<string_view>{"пушистый"sv, "хвост"sv}));
+
+    FuzzySearchOptions too_far;
+    too_far.max_distance = 3;
+    try {
+        server.EnableFuzzySearch(too_far);
+        ASSERT_HINT(false, "edit distance 3 must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestLoadCorpus() {
+    const CorpusRecord record = ParseCorpusRecord("7\tBANNED\t1 -2 3\tбелый кот"sv);
+    ASSERT_EQUAL(record.id, 7);
+    ASSERT(record.status == DocumentStatus::BANNED);
+    ASSERT_EQUAL(record.ratings, (vector<int>{1, -2, 3}));
+    ASSERT_EQUAL(record.text, "белый кот"sv);
+    for (const string_view invalid : {"7\tBANNED\tбелый кот"sv, "x\tACTUAL\t1\tкот"sv, "7\tNEW\t1\tкот"sv,
+                                      "7\tACTUAL\t\tкот"sv}) {
+        try {
+            ParseCorpusRecord(invalid);
+            ASSERT_HINT(false, "invalid corpus record must throw"s);
+        } catch (const invalid_argument&) {
+        }
+    }
+
+    const string path = (filesystem::temp_directory_path() / "search_server_test_corpus.tsv").string();
+    {
+        ofstream output(path);
+        output << "0\tACTUAL\t2 8 -3\tбелый кот и модный ошейник\n"s
+               << "1\tACTUAL\t3 7 2 7\tпушистый кот пушистый хвост\r\n"s
+               << "\n"s
+               << "2\tBANNED\t9\tухоженный пёс выразительные глаза"s;
+    }
+    SearchServer loaded("и в на"s);
+    ASSERT_EQUAL(LoadCorpus(loaded, path), 3u);
+    filesystem::remove(path);
+
+    SearchServer added("и в на"s);
+    added.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    added.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    added.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::BANNED, {9});
+    for (const string& query : {"пушистый кот"s, "пёс"s}) {
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            const auto expected = added.FindTopDocuments(query, status);
+            const auto actual = loaded.FindTopDocuments(query, status);
+            ASSERT_EQUAL(actual.size(), expected.size());
+            for (size_t i = 0; i < actual.size(); ++i) {
+                ASSERT_EQUAL(actual[i].id, expected[i].id);
+                ASSERT_EQUAL(actual[i].relevance, expected[i].relevance);
+                ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+            }
+        }
+    }
+    ASSERT_EQUAL(get<0>(loaded.MatchDocument("хвост"s, 1)), (vector<string_view>{"хвост"sv}));
+}
+
+void TestUpdateDocumentMetadata() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+
+    server.UpdateDocumentStatus(1, DocumentStatus::BANNED);
+    ASSERT_EQUAL(server.FindTopDocuments("кот"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("кот"s, DocumentStatus::BANNED)[0].id, 1);
+    ASSERT(get<1>(server.MatchDocument("кот"s, 1)) == DocumentStatus::BANNED);
+    ASSERT(server.FindTopDocumentsBatch({"кот"s})[0].size() == 1u);
+
+    server.UpdateDocumentRating(1, {10, 20});
+    ASSERT_EQUAL(server.FindTopDocuments("кот"s, DocumentStatus::BANNED)[0].rating, 15);
+    ASSERT_EQUAL(server.FindTopDocuments(execution::par, "кот"s, [](int, DocumentStatus, int rating) {
+        return rating > 10;
+    })[0].id, 1);
+    try {
+        server.UpdateDocumentStatus(5, DocumentStatus::BANNED);
+        ASSERT_HINT(false, "unknown document must throw"s);
+    } catch (const invalid_argument&) {
+    }
+
+    // updates race with queries: every query sees a document either banned or not
+    auto moderation = async(launch::async, [&server] {
+        for (int i = 0; i < 1000; ++i) {
+            server.UpdateDocumentStatus(0, i % 2 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL);
+        }
+    });
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT(server.FindTopDocuments("кот"s).size() <= 1u);
+    }
+    moderation.get();
+    ASSERT(server.FindTopDocuments("кот"s).size() == 1u);
+
+    // updates race with writers inserting into the document table
+    auto writer = async(launch::async, [&server] {
+        for (int id = 2; id < 502; ++id) {
+            server.AddDocument(id, "скворец "s + to_string(id), DocumentStatus::ACTUAL, {id});
+        }
+    });
+    auto updater = async(launch::async, [&server] {
+        for (int i = 0; i < 1000; ++i) {
+            server.UpdateDocumentRating(i % 2, {i});
+        }
+    });
+    writer.get();
+    updater.get();
+    ASSERT_EQUAL(server.GetDocumentCount(), 502);
+    ASSERT_EQUAL(server.FindTopDocuments("кот"s, DocumentStatus::BANNED)[0].rating, 999);
+
+    // a copy carries the metadata over and is updated on its own
+    SearchServer copy = server;
+    copy.UpdateDocumentStatus(1, DocumentStatus::ACTUAL);
+    ASSERT_EQUAL(copy.FindTopDocuments("кот"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments("кот"s).size(), 1u);
+    ASSERT_EQUAL(copy.FindTopDocuments("кот"s, [](int document_id, DocumentStatus, int) {
+        return document_id == 1;
+    })[0].rating, 999);
+    copy.AddDocument(502, "кот"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(copy.GetDocumentCount(), 503);
+    ASSERT_EQUAL(server.GetDocumentCount(), 502);
+}
+
+void TestQueryPlanner() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+    server.AddDocument(3, "белый кот и пушистый пёс"s, DocumentStatus::ACTUAL, {1});
+
+    const QueryPlan plan = server.PlanQuery("пёс кот хвост -модный"s);
+    ASSERT(plan.execution == QueryExecution::SEQUENTIAL);
+    ASSERT_EQUAL(plan.estimated_cost, 6u);
+    ASSERT_EQUAL(plan.plus_words.front().first, "хвост"s);
+    ASSERT_EQUAL(plan.plus_words.back().first, "кот"s);
+    ASSERT_EQUAL(plan.minus_words.size(), 1u);
+    ASSERT(server.PlanQuery("\"белый кот\" пёс"s).execution == QueryExecution::PRUNED);
+    ostringstream output;
+    output << server.PlanQuery("кот -пёс"s);
+    ASSERT_EQUAL(output.str(), "{ execution = SEQUENTIAL, estimated_cost = 3, +кот = 3, -пёс = 2 }"s);
+
+    // the execution chosen never changes the results
+    for (const string& query : {"пушистый кот -модный"s, "\"белый кот\" пушистый пёс"s,
+                                "\"белый кот\" пушистый -пёс"s, "\"пушистый кот\" хв*"s, "пёс глаза"s}) {
+        const auto expected = server.FindTopDocuments(query);
+        const auto actual = server.FindTopDocuments(adaptive_execution, query);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < actual.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT_EQUAL(actual[i].relevance, expected[i].relevance);
+        }
+    }
+    ASSERT_EQUAL(server.FindTopDocuments<Bm25Ranking>(adaptive_execution, "\"белый кот\" пёс"s)[0].relevance,
+                 server.FindTopDocuments<Bm25Ranking>("\"белый кот\" пёс"s)[0].relevance);
+}
+
+void TestConjunctiveQueries() {
+    {
+        PostingList postings;
+        for (int id = 0; id < 2000; id += 2) {
+            postings.Insert(id, 0.5, 2);
+        }
+        // few candidates are galloped to, many are compared block by block
+        vector<int> few = {1, 4, 1000, 1998, 2500};
+        IntersectDocuments(postings, few);
+        ASSERT_EQUAL(few, (vector<int>{4, 1000, 1998}));
+        vector<int> many(3000);
+        iota(many.begin(), many.end(), 0);
+        IntersectDocuments(postings, many);
+        ASSERT_EQUAL(many.size(), 1000u);
+        ASSERT_EQUAL(many.back(), 1998);
+    }
+
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+    server.AddDocument(3, "белый кот и пушистый пёс"s, DocumentStatus::ACTUAL, {1});
+
+    // a required word filters, the relevances stay those of the OR query
+    const auto any_word = server.FindTopDocuments("пушистый кот"s);
+    const auto required = server.FindTopDocuments("+пушистый кот"s);
+    ASSERT_EQUAL(any_word.size(), 3u);
+    ASSERT_EQUAL(required.size(), 2u);
+    for (const auto& document : required) {
+        ASSERT(document.id == 1 || document.id == 3);
+        const auto same = find_if(any_word.begin(), any_word.end(), [&document](const Document& other) {
+            return other.id == document.id;
+        });
+        ASSERT_EQUAL(same->relevance, document.relevance);
+    }
+    ASSERT(get<0>(server.MatchDocument("+пушистый кот"s, 0)).empty());
+    for (const string& invalid : {"+"s, "+-кот"s, "++кот"s, "+кот*"s}) {
+        try {
+            server.FindTopDocuments(invalid);
+            ASSERT_HINT(false, "invalid required word must throw"s);
+        } catch (const invalid_argument&) {
+        }
+    }
+
+    server.SetQueryMode(QueryMode::ALL_WORDS);
+    ASSERT_EQUAL(server.FindTopDocuments("белый кот"s).size(), 2u);
+    for (const auto& found : {server.FindTopDocuments("кот пёс"s), server.FindTopDocuments(execution::par, "кот пёс"s),
+                              server.FindTopDocuments(adaptive_execution, "кот пёс"s),
+                              server.FindTopDocumentsBatch({"кот пёс"s})[0]}) {
+        ASSERT_EQUAL(found.size(), 1u);
+        ASSERT_EQUAL(found[0].id, 3);
+    }
+    ASSERT(server.FindTopDocuments("кот пёс -пушистый"s).empty());
+    ASSERT(server.FindTopDocuments("кот слон"s).empty());
+    ASSERT(get<0>(server.MatchDocument("кот пёс"s, 0)).empty());
+    ASSERT_EQUAL(get<0>(server.MatchDocument(execution::par, "кот пёс"s, 3)), (vector<string_view>{"кот"sv, "пёс"sv}));
+    ASSERT_EQUAL(server.MatchDocuments("кот пёс"s, {0, 3}).words.size(), 2u);
+}
+
+void TestConcurrentAddDocument() {
+    const vector<string> texts = {"белый кот и модный ошейник"s, "пушистый кот пушистый хвост"s,
+                                  "ухоженный пёс выразительные глаза"s, "белый пёс и пушистый хвост"s};
+    const int document_count = 400;
+    SearchServer sequential("и в на"s);
+    for (int id = 0; id < document_count; ++id) {
+        sequential.AddDocument(id, texts[id % texts.size()] + " "s + to_string(id), DocumentStatus::ACTUAL, {id});
+    }
+
+    SearchServer concurrent("и в на"s);
+    const int writer_count = 8;
+    vector<future<void>> writers;
+    for (int writer = 0; writer < writer_count; ++writer) {
+        writers.push_back(async(launch::async, [&concurrent, &texts, writer] {
+            for (int id = writer; id < document_count; id += writer_count) {
+                concurrent.AddDocument(id, texts[id % texts.size()] + " "s + to_string(id), DocumentStatus::ACTUAL,
+                                       {id});
+            }
+        }));
+    }
+    for (auto& writer : writers) {
+        writer.get();
+    }
+    ASSERT_EQUAL(concurrent.GetDocumentCount(), document_count);
+    for (const string& query : {"пушистый кот"s, "белый -пёс"s, "хвост 17"s}) {
+        const auto expected = sequential.FindTopDocuments(query);
+        const auto actual = concurrent.FindTopDocuments(query);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < actual.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT_EQUAL(actual[i].relevance, expected[i].relevance);
+        }
+    }
+    try {
+        concurrent.AddDocument(5, "кот"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_HINT(false, "a taken id must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+
+    // a rejected text leaves the id free
+    try {
+        concurrent.AddDocument(document_count, "кот\x12"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_HINT(false, "an invalid text must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+
+    // allocated ids are unique and above the explicit ones; queries running
+    // alongside see every document either fully indexed or not at all
+    atomic<bool> writing{true};
+    auto reader = async(launch::async, [&concurrent, &writing] {
+        while (writing) {
+            const auto documents = concurrent.FindTopDocuments("скворец"s);
+            for (const auto& document : documents) {
+                ASSERT_EQUAL(document.relevance, documents[0].relevance);
+                ASSERT_EQUAL(get<0>(concurrent.MatchDocument("скворец"s, document.id)), vector<string_view>{"скворец"sv});
+            }
+        }
+    });
+    vector<future<vector<int>>> allocating;
+    for (int writer = 0; writer < 4; ++writer) {
+        allocating.push_back(async(launch::async, [&concurrent] {
+            vector<int> ids;
+            for (int i = 0; i < 50; ++i) {
+                ids.push_back(concurrent.AddDocument("скворец"s, DocumentStatus::ACTUAL, {1}));
+            }
+            return ids;
+        }));
+    }
+    set<int> allocated_ids;
+    for (auto& writer : allocating) {
+        for (const int id : writer.get()) {
+            ASSERT(id >= document_count);
+            allocated_ids.insert(id);
+        }
+    }
+    writing = false;
+    reader.get();
+    ASSERT_EQUAL(allocated_ids.size(), 200u);
+    ASSERT_EQUAL(concurrent.FindTopDocuments("скворец"s).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+}
+
+void TestTaskScheduler() {
+    // the caller of ParallelFor runs index 0 and cannot return to its own
+    // queue before index 1 has run, so another worker must steal its helper
+    {
+        TaskScheduler scheduler(2);
+        promise<void> outer_done;
+        scheduler.Submit([&scheduler, &outer_done] {
+            promise<void> second_started;
+            auto second_started_future = second_started.get_future();
+            scheduler.ParallelFor(2, [&](size_t index) {
+                if (index == 0) {
+                    ASSERT(second_started_future.wait_for(chrono::seconds(10)) == future_status::ready);
+                } else {
+                    second_started.set_value();
+                }
+            });
+            outer_done.set_value();
+        });
+        outer_done.get_future().get();
+    }
+
+    // nested loops on a pool smaller than the outer loop
+    {
+        TaskScheduler scheduler(2);
+        atomic<int> sum{0};
+        scheduler.ParallelFor(16, [&](size_t i) {
+            scheduler.ParallelFor(8, [&](size_t j) {
+                sum += static_cast<int>(i * j);
+            });
+        });
+        ASSERT_EQUAL(sum.load(), 120 * 28);
+    }
+
+    // every call runs even when some throw
+    {
+        TaskScheduler scheduler(4);
+        atomic<int> calls{0};
+        try {
+            scheduler.ParallelFor(100, [&calls](size_t i) {
+                ++calls;
+                if (i % 10 == 3) {
+                    throw runtime_error("task "s + to_string(i));
+                }
+            });
+            ASSERT_HINT(false, "the exception must reach the caller"s);
+        } catch (const runtime_error&) {
+        }
+        ASSERT_EQUAL(calls.load(), 100);
+    }
+
+    // tasks still queued when the scheduler is destroyed are run
+    atomic<int> submitted_runs{0};
+    {
+        TaskScheduler scheduler(1);
+        promise<void> release;
+        auto released = release.get_future().share();
+        scheduler.Submit([released] {
+            released.wait();
+        });
+        for (int i = 0; i < 100; ++i) {
+            scheduler.Submit([&submitted_runs] {
+                ++submitted_runs;
+            });
+        }
+        release.set_value();
+    }
+    ASSERT_EQUAL(submitted_runs.load(), 100);
+}
+
+void TestNumaPlacement() {
+    const auto node_cpus = GetNumaNodeCpus();
+    ASSERT(!node_cpus.empty());
+    for (const auto& cpus : node_cpus) {
+        ASSERT(!cpus.empty());
+    }
+
+    // pinned workers run nested loops like unpinned ones
+    TaskScheduler scheduler(4, TaskScheduler::ThreadPlacement::NUMA_NODES);
+    ASSERT_EQUAL(scheduler.GetThreadCount(), 4u);
+    vector<int> sums(64);
+    scheduler.ParallelFor(sums.size(), [&](size_t i) {
+        vector<int> parts(8);
+        scheduler.ParallelFor(parts.size(), [&](size_t j) {
+            parts[j] = static_cast<int>(i * j);
+        });
+        sums[i] = accumulate(parts.begin(), parts.end(), 0);
+    });
+    for (size_t i = 0; i < sums.size(); ++i) {
+        ASSERT_EQUAL(sums[i], static_cast<int>(i * 28));
+    }
+
+    TaskScheduler::Instance();
+    try {
+        TaskScheduler::SetDefaultPlacement(TaskScheduler::ThreadPlacement::NUMA_NODES);
+        ASSERT_HINT(false, "the running shared pool cannot be re-placed"s);
+    } catch (const logic_error&) {
+    }
+}
+
+void TestStandingQueries() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "пушистый кот"s, DocumentStatus::ACTUAL, {1});
+    map<int, vector<int>> matches;
+    auto record = [&matches](int query_id, int document_id) {
+        matches[query_id].push_back(document_id);
+    };
+    const int any_cat = server.AddStandingQuery("пушистый кот -ошейник"s, record);
+    const int required_dog = server.AddStandingQuery("+пёс хвост"s, record);
+    const int phrase = server.AddStandingQuery("\"белый кот\""s, record);
+    const int banned = server.AddStandingQuery("кот"s, record, DocumentStatus::BANNED);
+    server.SetQueryMode(QueryMode::ALL_WORDS);
+    const int all_words = server.AddStandingQuery("кот и хвост"s, record);
+    try {
+        server.AddStandingQuery("ко*"s, record);
+        ASSERT_HINT(false, "wildcards must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+
+    server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(3, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(4, "белый пёс и пушистый хвост"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(5, "кот белый"s, DocumentStatus::BANNED, {1});
+    ASSERT(matches.count(any_cat) && matches.at(any_cat) == vector<int>({2, 4}));
+    ASSERT(matches.count(required_dog) && matches.at(required_dog) == vector<int>({3, 4}));
+    ASSERT(matches.count(phrase) && matches.at(phrase) == vector<int>({1}));
+    ASSERT(matches.count(banned) && matches.at(banned) == vector<int>({5}));
+    ASSERT(matches.count(all_words) && matches.at(all_words) == vector<int>({2}));
+
+    // the same documents FindTopDocuments finds among the new ones
+    server.SetQueryMode(QueryMode::ANY_WORD);
+    for (const int document_id : matches.at(any_cat)) {
+        const auto found = server.FindTopDocuments("пушистый кот -ошейник"s);
+        ASSERT(any_of(found.begin(), found.end(), [document_id](const Document& document) {
+            return document.id == document_id;
+        }));
+    }
+
+    server.RemoveStandingQuery(any_cat);
+    server.AddDocument(6, "пушистый кот"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(matches.at(any_cat).size(), 2u);
+    try {
+        server.RemoveStandingQuery(any_cat);
+        ASSERT_HINT(false, "a removed query id must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
 void TestMatchDocument() {
     const int doc_id_0 = 42;
     const string content_0 = "cat in the city"s;
@@ -97,6 +714,33 @@ void TestMatchDocument() {
     }
 }
 
+void TestMatchDocuments() {
+    SearchServer server("in the"s);
+    server.AddDocument(42, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    server.AddDocument(43, "dog in the city"s, DocumentStatus::BANNED, {5, 6, 8});
+    server.AddDocument(44, "big cat and big dog"s, DocumentStatus::ACTUAL, {1});
+    
+    const auto matches = server.MatchDocuments("cat city dog -and"s, {43, 42, 44});
+    ASSERT_EQUAL(matches.size(), 3u);
+    ASSERT_EQUAL(matches.offsets, vector<size_t>({0, 2, 4, 4}));
+    ASSERT_EQUAL(matches.words, vector<string_view>({"city"sv, "dog"sv, "cat"sv, "city"sv}));
+    ASSERT(matches.statuses[0] == DocumentStatus::BANNED);
+    ASSERT(matches.statuses[1] == DocumentStatus::ACTUAL);
+    
+    for (size_t i = 0; i < matches.size(); ++i) {
+        const int id = vector<int>{43, 42, 44}[i];
+        const auto [words, status] = server.MatchDocument("cat city dog -and"s, id);
+        ASSERT_EQUAL(words, vector<string_view>(matches.words.begin() + matches.offsets[i],
+                                                matches.words.begin() + matches.offsets[i + 1]));
+    }
+    
+    try {
+        server.MatchDocuments("cat"s, {42, 7});
+        ASSERT_HINT(false, "Unknown document id must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
 void TestDocumentsSortedByRelevance() {
     SearchServer server("и в на"s);
     server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
@@ -194,14 +838,498 @@ void TestCorrectRelevanceComputation() {
     ASSERT(delta < epsilon);
 }
 
+void TestBm25Ranking() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+
+    // document lengths without stop words are 4, 4 and 4
+    const double k1 = Bm25Ranking::K1;
+    const double b = Bm25Ranking::B;
+    auto idf = [](double document_freq) {
+        return log((3 - document_freq + 0.5) / (document_freq + 0.5) + 1.0);
+    };
+    auto weight = [k1, b](double occurrence_count, double length, double average_length) {
+        return occurrence_count * (k1 + 1) / (occurrence_count + k1 * (1 - b + b * length / average_length));
+    };
+    const double expected_relevance = idf(1) * weight(2, 4, 4) + idf(2) * weight(1, 4, 4);
+    const auto found_docs = server.FindTopDocuments<Bm25Ranking>("пушистый кот"s);
+    ASSERT_EQUAL(found_docs.size(), 2u);
+    ASSERT_EQUAL(found_docs[0].id, 1);
+    ASSERT(abs(found_docs[0].relevance - expected_relevance) < 1e-6);
+    ASSERT_EQUAL(found_docs[1].id, 0);
+    ASSERT(abs(found_docs[1].relevance - idf(2) * weight(1, 4, 4)) < 1e-6);
+
+    // a longer document is penalized for the same number of occurrences
+    server.AddDocument(3, "кот кот"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(4, "кот кот сидит на окне и смотрит на улицу"s, DocumentStatus::ACTUAL, {1});
+    const auto par_docs = server.FindTopDocuments<Bm25Ranking>(execution::par, "кот"s);
+    const auto seq_docs = server.FindTopDocuments<Bm25Ranking>(execution::seq, "кот"s);
+    ASSERT_EQUAL(seq_docs.size(), 4u);
+    ASSERT_EQUAL(seq_docs[0].id, 3);
+    ASSERT_EQUAL(seq_docs[1].id, 4);
+    ASSERT(seq_docs[0].relevance > seq_docs[1].relevance);
+    ASSERT_EQUAL(par_docs.size(), seq_docs.size());
+    for (size_t i = 0; i < seq_docs.size(); ++i) {
+        ASSERT_EQUAL(par_docs[i].id, seq_docs[i].id);
+        ASSERT_EQUAL(par_docs[i].relevance, seq_docs[i].relevance);
+    }
+}
+
+// Recomputes relevances from the forward index in double precision and
+// checks that the scoring kernel ranks the same top documents, whether term
+// frequencies are stored exactly or as float.
+void TestScoringKernelKeepsTopDocuments() {
+    const vector<string> vocabulary = {"кот"s, "пёс"s, "хвост"s, "ошейник"s, "глаза"s, "скворец"s,
+                                       "белый"s, "пушистый"s, "модный"s, "ухоженный"s, "евгений"s};
+    SearchServer server("и в на"s);
+    uint32_t seed = 17;
+    auto next_random = [&seed] {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) & 0x7fff;
+    };
+    for (int id = 0; id < 300; ++id) {
+        string text;
+        const int word_count = 1 + next_random() % 12;
+        for (int i = 0; i < word_count; ++i) {
+            text += vocabulary[next_random() % vocabulary.size()] + " "s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {static_cast<int>(next_random() % 10)});
+    }
+
+    map<string_view, int> document_freqs;
+    for (const int document_id : server) {
+        for (const auto& [word, freq] : server.GetWordFrequencies(document_id)) {
+            ++document_freqs[word];
+        }
+    }
+    const vector<pair<vector<string_view>, vector<string_view>>> queries = {
+        {{"кот"sv, "пушистый"sv}, {}},
+        {{"глаза"sv, "ошейник"sv, "пёс"sv, "хвост"sv}, {"белый"sv}},
+        {{"евгений"sv, "модный"sv, "скворец"sv, "ухоженный"sv}, {}},
+        // every word at once, so float rounding accumulates the most
+        {{"белый"sv, "глаза"sv, "евгений"sv, "кот"sv, "модный"sv, "ошейник"sv, "пёс"sv, "пушистый"sv,
+          "скворец"sv, "ухоженный"sv, "хвост"sv}, {}},
+    };
+    for (const auto& [plus_words, minus_words] : queries) {
+        vector<Document> expected;
+        for (const int document_id : server) {
+            map<string_view, double> word_freqs;
+            for (const auto& [word, freq] : server.GetWordFrequencies(document_id)) {
+                word_freqs[word] = freq;
+            }
+            if (any_of(minus_words.begin(), minus_words.end(),
+                       [&word_freqs](string_view word) { return word_freqs.count(word) > 0; })) {
+                continue;
+            }
+            double relevance = 0.0;
+            bool has_plus_word = false;
+            for (const auto word : plus_words) {
+                if (word_freqs.count(word) > 0) {
+                    has_plus_word = true;
+                    relevance += word_freqs.at(word) * log(server.GetDocumentCount() * 1.0 / document_freqs.at(word));
+                }
+            }
+            if (has_plus_word) {
+                expected.push_back({document_id, relevance, 0});
+            }
+        }
+
+        string raw_query;
+        for (const auto word : plus_words) {
+            raw_query += string{word} + " "s;
+        }
+        for (const auto word : minus_words) {
+            raw_query += "-"s + string{word} + " "s;
+        }
+        for (const auto& found : {server.FindTopDocuments(execution::seq, raw_query),
+                                  server.FindTopDocuments(execution::par, raw_query)}) {
+            vector<Document> expected_top;
+            for (const auto& document : found) {
+                const auto it = find_if(expected.begin(), expected.end(),
+                                        [&document](const Document& candidate) {
+                                            return candidate.id == document.id;
+                                        });
+                ASSERT(it != expected.end());
+                // float term frequencies move a relevance by about 1e-7 of it
+                ASSERT(abs(it->relevance - document.relevance) <= 1e-6 * abs(it->relevance));
+                expected_top.push_back(*it);
+            }
+            ASSERT_EQUAL(found.size(), min<size_t>(expected.size(), MAX_RESULT_DOCUMENT_COUNT));
+            // nothing outside the result may outrank its last document
+            for (const auto& document : expected) {
+                const bool is_found = any_of(found.begin(), found.end(),
+                                             [&document](const Document& top) { return top.id == document.id; });
+                if (!is_found) {
+                    ASSERT(document.relevance <= expected_top.back().relevance * (1.0 + 2e-6));
+                }
+            }
+        }
+    }
+}
+
+void TestFindTopDocumentsPage() {
+    SearchServer server("and with"s);
+    for (int id = 0; id < 12; ++id) {
+        server.AddDocument(id, "cat "s + string(id % 4 + 1, 'x'), DocumentStatus::ACTUAL, {id});
+    }
+    server.AddDocument(12, "dog"s, DocumentStatus::ACTUAL, {1});
+    
+    vector<int> paged_ids;
+    PageCursor cursor;
+    int page_count = 0;
+    while (!cursor.IsEnd()) {
+        const auto page = server.FindTopDocumentsPage("cat"s, cursor, 5);
+        ASSERT(page.documents.size() <= 5u);
+        for (const auto& document : page.documents) {
+            paged_ids.push_back(document.id);
+        }
+        cursor = page.next_page;
+        ++page_count;
+    }
+    ASSERT_EQUAL(page_count, 3);
+    ASSERT_EQUAL(paged_ids, vector<int>({11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0}));
+    
+    const auto third_page = server.FindTopDocumentsPage("cat"s, size_t{2}, 5);
+    vector<int> third_page_ids;
+    for (const auto& document : third_page.documents) {
+        third_page_ids.push_back(document.id);
+    }
+    ASSERT_EQUAL(third_page_ids, vector<int>({1, 0}));
+    ASSERT(third_page.next_page.IsEnd());
+    ASSERT(server.FindTopDocumentsPage("cat"s, size_t{3}, 5).documents.empty());
+
+    server.AddDocument(13, "cat"s, DocumentStatus::BANNED, {1});
+    const auto banned_page = server.FindTopDocumentsPage("cat"s, size_t{0}, 5, DocumentStatus::BANNED);
+    ASSERT_EQUAL(banned_page.documents.size(), 1u);
+    ASSERT_EQUAL(banned_page.documents[0].id, 13);
+    ASSERT_EQUAL(server.FindTopDocumentsPage("cat"s, PageCursor{}, 5, DocumentStatus::BANNED).documents.size(), 1u);
+    const auto even_page = server.FindTopDocumentsPage("cat"s, size_t{1}, 2, [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    });
+    vector<int> even_ids;
+    for (const auto& document : even_page.documents) {
+        even_ids.push_back(document.id);
+    }
+    ASSERT_EQUAL(even_ids, vector<int>({6, 4}));
+}
+
+void TestRequestQueueCountsNoResultRequestsInWindow() {
+    SearchServer server("and in at"s);
+    RequestQueue request_queue(server);
+    server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    
+    for (int i = 0; i < 1439; ++i) {
+        request_queue.AddFindRequest("empty request"s);
+    }
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1439);
+    request_queue.AddFindRequest("curly dog"s);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1439);
+    request_queue.AddFindRequest("big collar"s);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1438);
+    request_queue.AddFindRequest("sparrow"s);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1438);
+}
+
+void TestQueryAnalytics() {
+    QueryAnalytics analytics;
+    SearchServer server("and in at"s);
+    server.SetQueryAnalytics(&analytics);
+    server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    
+    for (int i = 0; i < 5; ++i) {
+        server.FindTopDocuments("curly cat"s);
+    }
+    server.FindTopDocuments("sparrow"s);
+    server.FindTopDocuments("curly"s);
+    
+    const auto snapshot = analytics.GetSnapshot();
+    ASSERT_EQUAL(snapshot.request_count, 7u);
+    ASSERT_EQUAL(snapshot.no_result_count, 1u);
+    ASSERT_EQUAL(snapshot.heavy_hitters.size(), 3u);
+    ASSERT_EQUAL(snapshot.heavy_hitters[0].first, "curly cat"s);
+    ASSERT_EQUAL(snapshot.heavy_hitters[0].second, 5u);
+    
+    const auto later = QueryAnalytics::Clock::now() + std::chrono::minutes(QueryAnalytics::WINDOW_MINUTES);
+    ASSERT_EQUAL(analytics.GetSnapshot(later).request_count, 0u);
+}
+
+void TestMetricsHistogram() {
+    for (uint64_t value : {0ull, 7ull, 8ull, 1000ull, 123456789ull}) {
+        const size_t bucket = Metrics::ToBucket(value);
+        ASSERT(value <= Metrics::GetBucketUpperBound(bucket));
+        ASSERT(bucket == 0 || value > Metrics::GetBucketUpperBound(bucket - 1));
+    }
+    
+    Metrics::Reset();
+    for (uint64_t ns = 1; ns <= 1000; ++ns) {
+        Metrics::Record(Metric::POSTING_SCAN, ns * 1000);
+    }
+    const auto snapshot = Metrics::GetSnapshot();
+    const auto& histogram = snapshot.histograms[static_cast<size_t>(Metric::POSTING_SCAN)];
+    ASSERT_EQUAL(histogram.count, 1000u);
+    const uint64_t median = histogram.GetQuantileNs(0.5);
+    ASSERT(median >= 500'000 && median <= 500'000 * 9 / 8);
+    
+    ostringstream output;
+    snapshot.WritePrometheus(output);
+    ASSERT(output.str().find("search_server_posting_scan_seconds_count 1000"s) != string::npos);
+    Metrics::Reset();
+}
+
+void TestProcessQueriesMatchesSequentialSearch() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+    server.AddDocument(3, "ухоженный скворец евгений"s, DocumentStatus::BANNED, {9});
+    
+    const vector<string> queries = {
+        "пушистый ухоженный кот"s,
+        "кот"s,
+        "ухоженный -пёс"s,
+        "белый модный ошейник пушистый хвост выразительные глаза скворец"s,
+        "несуществующее"s
+    };
+    const auto results = ProcessQueries(server, queries);
+    ASSERT_EQUAL(results.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments(queries[i]);
+        ASSERT_EQUAL(results[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL(results[i][j].id, expected[j].id);
+        }
+    }
+
+    // a query over more than 1 << 14 postings runs as its own parallel task
+    for (int id = 4; id < 9004; ++id) {
+        server.AddDocument(id, "рыжий кот и рыжий пёс "s + to_string(id), DocumentStatus::ACTUAL, {id % 7});
+    }
+    const vector<string> heavy_queries = {"рыжий пёс"s, "евгений"s, "кот -рыжий"s};
+    ASSERT(server.EstimateQueryCost(heavy_queries[0]) >= size_t{1 << 14});
+    const auto heavy_results = ProcessQueries(server, heavy_queries);
+    for (size_t i = 0; i < heavy_queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments(heavy_queries[i]);
+        ASSERT_EQUAL(heavy_results[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL(heavy_results[i][j].id, expected[j].id);
+            ASSERT_EQUAL(heavy_results[i][j].relevance, expected[j].relevance);
+        }
+    }
+}
+
+void TestProcessQueriesBatchedMatchesSequentialSearch() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+    server.AddDocument(3, "ухоженный скворец евгений"s, DocumentStatus::BANNED, {9});
+    
+    const vector<string> queries = {
+        "пушистый ухоженный кот"s,
+        "кот -пушистый"s,
+        "ухоженный кот"s,
+        "пёс пёс пёс"s,
+        "несуществующее"s
+    };
+    const auto results = ProcessQueriesBatched(server, queries);
+    ASSERT_EQUAL(results.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments(queries[i]);
+        ASSERT_EQUAL(results[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL(results[i][j].id, expected[j].id);
+            ASSERT_EQUAL(results[i][j].relevance, expected[j].relevance);
+        }
+    }
+
+    const auto bm25_results = server.FindTopDocumentsBatch<Bm25Ranking>(queries);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments<Bm25Ranking>(queries[i]);
+        ASSERT_EQUAL(bm25_results[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL(bm25_results[i][j].id, expected[j].id);
+            ASSERT_EQUAL(bm25_results[i][j].relevance, expected[j].relevance);
+        }
+    }
+
+    // one call per matched document of a query, not one per posting
+    size_t predicate_calls = 0;
+    server.FindTopDocumentsBatch({"пушистый ухоженный кот"s}, [&predicate_calls](int, DocumentStatus, int) {
+        ++predicate_calls;
+        return true;
+    });
+    ASSERT_EQUAL(predicate_calls, 4u);
+}
+
+void TestFindTopDocumentsAsyncRespectsBudget() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+    const string query = "пушистый ухоженный кот"s;
+    
+    {
+        const auto result = server.FindTopDocumentsAsync(query, QueryBudget{}).get();
+        const auto expected = server.FindTopDocuments(query);
+        ASSERT(result.status == QueryStatus::COMPLETE);
+        ASSERT_EQUAL(result.documents.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(result.documents[i].id, expected[i].id);
+        }
+    }
+    
+    {
+        QueryBudget budget;
+        budget.token.Cancel();
+        const auto result = server.FindTopDocumentsAsync(query, budget).get();
+        ASSERT(result.status == QueryStatus::CANCELLED);
+        ASSERT(result.documents.empty());
+    }
+    
+    {
+        QueryBudget budget;
+        budget.deadline = QueryBudget::Clock::now();
+        const auto result = server.FindTopDocumentsAsync(query, budget).get();
+        ASSERT(result.status == QueryStatus::TIMEOUT);
+    }
+
+    // required words and phrases take the pruned path, which must honour
+    // the budget too and never return candidates it could not verify
+    {
+        string filler;
+        for (int i = 0; i < 200; ++i) {
+            filler += " трава"s;
+        }
+        for (int id = 3; id < 2003; ++id) {
+            server.AddDocument(id, "кот"s + filler + " пёс"s, DocumentStatus::ACTUAL, {1});
+        }
+        const string pruned_query = "+кот \"пёс кот\""s;
+        ASSERT(server.FindTopDocumentsAsync(pruned_query, QueryBudget{}).get().status == QueryStatus::COMPLETE);
+        QueryBudget expired_budget;
+        expired_budget.deadline = QueryBudget::Clock::now();
+        const auto timed_out = server.FindTopDocumentsAsync(pruned_query, expired_budget).get();
+        ASSERT(timed_out.status == QueryStatus::TIMEOUT);
+        ASSERT(timed_out.documents.empty());
+        QueryBudget cancelled_budget;
+        cancelled_budget.token.Cancel();
+        const auto cancelled = server.FindTopDocumentsAsync(pruned_query, cancelled_budget).get();
+        ASSERT(cancelled.status == QueryStatus::CANCELLED);
+        ASSERT(cancelled.documents.empty());
+    }
+}
+
+void TestRemoveDocuments() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+    server.AddDocument(3, "ухоженный скворец евгений"s, DocumentStatus::ACTUAL, {9});
+    
+    server.RemoveDocuments({3, 1, 42, 1});
+    ASSERT_EQUAL(server.GetDocumentCount(), 2);
+    ASSERT_EQUAL(vector<int>(server.begin(), server.end()), vector<int>({0, 2}));
+    ASSERT(server.GetWordFrequencies(1).empty());
+    ASSERT(server.FindTopDocuments("пушистый скворец"s).empty());
+    
+    const auto found_docs = server.FindTopDocuments("ухоженный кот"s);
+    ASSERT_EQUAL(found_docs.size(), 2u);
+    ASSERT_EQUAL(found_docs[0].id, 0);
+    ASSERT_EQUAL(found_docs[1].id, 2);
+
+    // one by one or in a batch, emptied posting lists are dropped alike
+    SearchServer one_by_one("и в на"s);
+    one_by_one.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {2, 8, -3});
+    one_by_one.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {3, 7, 2, 7});
+    one_by_one.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {4, 5, -12, 2, 1});
+    one_by_one.AddDocument(3, "ухоженный скворец евгений"s, DocumentStatus::ACTUAL, {9});
+    one_by_one.RemoveDocument(3);
+    one_by_one.RemoveDocument(1);
+    ASSERT_EQUAL(one_by_one.GetIndexMemoryUsage().postings, server.GetIndexMemoryUsage().postings);
+}
+
+void TestRemoveDuplicates() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(3, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(4, "funny pet and curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(5, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(6, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(7, "very nasty rat and not very funny pet"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(8, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    
+    const auto report = RemoveDuplicates(server);
+    const vector<int> expected_removed = {3, 4, 5, 7};
+    ASSERT_EQUAL(report.removed_ids, expected_removed);
+    ASSERT_EQUAL(server.GetDocumentCount(), 5);
+}
+
+void TestRemoveNearDuplicates() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "a b c d e f g h i j k l m n o p q r s t"s, DocumentStatus::ACTUAL, {1});
+    map<int, vector<int>> reported;
+    server.EnableNearDuplicateDetection({}, [&reported](int document_id, const vector<int>& near_duplicate_ids) {
+        reported[document_id] = near_duplicate_ids;
+    });
+    server.AddDocument(2, "a b c d e f g h i j k l m n o p q r s t u"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(3, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(4, "a b c d e f g h i j k l m n o p q r s t"s, DocumentStatus::ACTUAL, {1});
+    // documents of stop words only have no word set to compare
+    server.AddDocument(5, "and with"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(6, "with"s, DocumentStatus::ACTUAL, {1});
+
+    // new near-copies are reported as they arrive
+    ASSERT_EQUAL(reported.size(), 2u);
+    ASSERT_EQUAL(reported.at(2), vector<int>({1}));
+    ASSERT_EQUAL(reported.at(4), vector<int>({1, 2}));
+    ASSERT_EQUAL(server.FindNearDuplicates(1), vector<int>({2, 4}));
+    ASSERT(server.FindNearDuplicates(3).empty());
+    ASSERT(server.FindNearDuplicates(6).empty());
+    
+    const auto report = RemoveNearDuplicates(server);
+    ASSERT_EQUAL(report.removed_ids, vector<int>({2, 4}));
+    ASSERT_EQUAL(server.GetDocumentCount(), 4);
+    ASSERT(server.FindNearDuplicates(1).empty());
+}
+
 void TestSearchServer() {
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
     RUN_TEST(TestAddDocument);
     RUN_TEST(TestDocumentsWithMinusWordsExcludedFromSearchResults); 
+    RUN_TEST(TestGetWordFrequencies);
+    RUN_TEST(TestPhraseQueries);
+    RUN_TEST(TestTermDictionary);
+    RUN_TEST(TestPatternQueries);
+    RUN_TEST(TestFuzzySearch);
+    RUN_TEST(TestLoadCorpus);
+    RUN_TEST(TestUpdateDocumentMetadata);
+    RUN_TEST(TestQueryPlanner);
+    RUN_TEST(TestConjunctiveQueries);
+    RUN_TEST(TestConcurrentAddDocument);
+    RUN_TEST(TestTaskScheduler);
+    RUN_TEST(TestNumaPlacement);
+    RUN_TEST(TestStandingQueries);
     RUN_TEST(TestMatchDocument);
+    RUN_TEST(TestMatchDocuments);
     RUN_TEST(TestDocumentsSortedByRelevance);
     RUN_TEST(TestComputeAverageRating);
     RUN_TEST(TestResultsFilterUsingPredicate);
     RUN_TEST(TestFindTopDocumentsWithDefiniteStatus);
     RUN_TEST(TestCorrectRelevanceComputation);
+    RUN_TEST(TestBm25Ranking);
+    RUN_TEST(TestScoringKernelKeepsTopDocuments);
+    RUN_TEST(TestFindTopDocumentsPage);
+    RUN_TEST(TestRequestQueueCountsNoResultRequestsInWindow);
+    RUN_TEST(TestQueryAnalytics);
+    RUN_TEST(TestMetricsHistogram);
+    RUN_TEST(TestProcessQueriesMatchesSequentialSearch);
+    RUN_TEST(TestProcessQueriesBatchedMatchesSequentialSearch);
+    RUN_TEST(TestFindTopDocumentsAsyncRespectsBudget);
+    RUN_TEST(TestRemoveDocuments);
+    RUN_TEST(TestRemoveDuplicates);
+    RUN_TEST(TestRemoveNearDuplicates);
 }
@@ -76,7 +76,7 @@ void AssertEqualImpl(const T& t, const U& u, const std::string& t_str, const std
 
 #define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
 
-void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line,
+inline void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line,
                 const std::string& hint) {
     using namespace std;
     if (!value) {
@@ -102,3 +102,5 @@ void RunTestImpl(TestFunc func, const std::string& test_func_name) {
 }
 
 #define RUN_TEST(func)  RunTestImpl(func, #func)
+
+void TestSearchServer();
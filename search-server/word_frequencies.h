@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct TermFrequency {
+    int term_id;
+    double freq;
+
+    bool operator<(const TermFrequency& other) const {
+        return term_id < other.term_id;
+    }
+};
+
+// Read-only view of one document's forward index entry: (term id, tf) pairs
+// sorted by term id, resolved to words through the server's term dictionary.
+// Iteration yields std::pair<std::string_view, double>. The view is valid
+// until the document is removed.
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const TermFrequency* position, const std::vector<std::string_view>* terms)
+            : position_(position)
+            , terms_(terms) {
+        }
+
+        value_type operator*() const {
+            return {(*terms_)[position_->term_id], position_->freq};
+        }
+
+        int GetTermId() const {
+            return position_->term_id;
+        }
+
+        Iterator& operator++() {
+            ++position_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++position_;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return position_ == other.position_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return position_ != other.position_;
+        }
+
+    private:
+        const TermFrequency* position_;
+        const std::vector<std::string_view>* terms_;
+    };
+
+    WordFrequencies() = default;
+
+    WordFrequencies(const std::vector<TermFrequency>& entries, const std::vector<std::string_view>& terms)
+        : begin_(entries.data())
+        , end_(entries.data() + entries.size())
+        , terms_(&terms) {
+    }
+
+    Iterator begin() const {
+        return {begin_, terms_};
+    }
+
+    Iterator end() const {
+        return {end_, terms_};
+    }
+
+    size_t size() const {
+        return end_ - begin_;
+    }
+
+    bool empty() const {
+        return begin_ == end_;
+    }
+
+    bool ContainsTerm(int term_id) const {
+        return std::binary_search(begin_, end_, TermFrequency{term_id, 0.0});
+    }
+
+    // Word sets are equal iff the sorted term id sequences are equal.
+    bool HasSameTerms(const WordFrequencies& other) const {
+        return std::equal(begin_, end_, other.begin_, other.end_,
+                          [](const TermFrequency& lhs, const TermFrequency& rhs) {
+                              return lhs.term_id == rhs.term_id;
+                          });
+    }
+
+private:
+    const TermFrequency* begin_ = nullptr;
+    const TermFrequency* end_ = nullptr;
+    const std::vector<std::string_view>* terms_ = nullptr;
+};